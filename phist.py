@@ -9,31 +9,68 @@ https://github.com/refresh-bio/PHIST
 
 from __future__ import annotations
 import argparse
+import gzip
+import hashlib
+import json
 import multiprocessing
+import os
 import platform
 from pathlib import Path
+import shutil
 import subprocess
 import sys
+from typing import Iterator
 
 __version__ = '1.2.1'
 
 
+def parse_k_list(value: str) -> list[int]:
+    """Parses a k-mer length or comma-separated k-mer lengths."""
+    try:
+        return [int(k) for k in value.split(',')]
+    except ValueError:
+        raise argparse.ArgumentTypeError(f'invalid k-mer length: {value}')
+
+
 def get_parser() -> argparse.ArgumentParser:
     desc = f'PHIST predicts hosts from phage (meta)genomic data'
     p = argparse.ArgumentParser(description=desc)
     p.add_argument('virus_path',
                    help='Input FASTA file or directory with FASTA files (plain or gzip)')
     p.add_argument('host_dir', metavar='host_dir',
-                   help='Input directory w/ host FASTA files (plain or gzip)')
+                   help='Input directory w/ host FASTA files (plain or gzip) '
+                   'or a host archive created by utils/archiver')
     p.add_argument('out_dir', metavar='out_dir', nargs='+',
                    help='Output directory (will be created if it does not exist)')
-    p.add_argument('-k', dest='k', type=int,
-                   default=25, help='k-mer length [default =  %(default)s]')
+    p.add_argument('-k', dest='k_list', type=parse_k_list,
+                   default=[25], help='k-mer length or comma-separated '
+                   'lengths (e.g. 21,25,29) extracted in a single pass with '
+                   'predictions per length [default = 25]')
     p.add_argument('-t', dest='num_threads', type=int,
                    default=multiprocessing.cpu_count(),
                    help='Number of threads [default = %(default)s]')
     p.add_argument('--keep_temp', action="store_true",
                    help='Keep temporary kmer-db files [%(default)s]')
+    p.add_argument('--batch_size', dest='batch_size', type=int,
+                   default=0,
+                   help='Process virus multi-FASTA in batches of given '
+                   'number of records (0 - whole file) [default = %(default)s]')
+    p.add_argument('--checkpoint', action="store_true",
+                   help='Compare hosts in batches and keep completed work '
+                   'in out_dir/checkpoint, so that an interrupted run '
+                   'restarted with the same inputs resumes [%(default)s]')
+    p.add_argument('--host_batch_size', dest='host_batch_size', type=int,
+                   default=1000,
+                   help='Number of host files per checkpointed batch '
+                   '[default = %(default)s]')
+    p.add_argument('--cache_dir', dest='cache_dir', type=Path,
+                   default=None,
+                   help='Directory where virus databases are stored under '
+                   'a hash of the inputs and reused by later runs '
+                   '[default = no caching]')
+    p.add_argument('--numa', action="store_true",
+                   help='Interleave memory of kmer-db runs over all NUMA '
+                   'nodes (requires numactl) [%(default)s]')
     p.add_argument('--version', action='version',
                    version=__version__,
                    help="Show tool's version number and exit")
@@ -56,18 +93,51 @@ def validate_args(parser: argparse.ArgumentParser) -> argparse.Namespace:
     args = parser.parse_args()
     
     # Validate k-mer length
-    if args.k < 3 or args.k > 30:
+    if any(k < 3 or k > 30 for k in args.k_list):
         parser.error(f'K-mer length should be in range 3-30.')
+    if len(set(args.k_list)) != len(args.k_list):
+        parser.error(f'K-mer lengths should be distinct.')
+    args.k = args.k_list[0]
+    args.multi_k = len(args.k_list) > 1
 
     # Validate virus input
     v_path = Path(args.virus_path)
     if not v_path.exists():
         parser.error(f'Virus input does not exist: {v_path}')
 
+    # Validate batch size
+    if args.batch_size < 0:
+        parser.error(f'Batch size should be non-negative.')
+    if args.batch_size > 0 and v_path.is_dir():
+        parser.error(f'Batches are supported only for virus multi-FASTA input.')
+
+    # Validate checkpointing
+    if args.host_batch_size < 1:
+        parser.error(f'Host batch size should be positive.')
+
+    # Validate cache directory
+    if args.cache_dir is not None:
+        if args.cache_dir.exists() and not args.cache_dir.is_dir():
+            parser.error(f'Cache path is not a directory: {args.cache_dir}')
+        args.cache_dir.mkdir(parents=True, exist_ok=True)
+
+    # Validate NUMA support
+    args.numactl = shutil.which('numactl') if args.numa else None
+    if args.numa and args.numactl is None:
+        print('Warning: numactl not found - NUMA interleaving disabled')
+
     # Validate host input
     hdir_path = Path(args.host_dir)
-    if not hdir_path.exists() or not hdir_path.is_dir():
-        parser.error(f'Input host directory does not exist: {hdir_path}')
+    args.host_archive = hdir_path.is_file() and is_host_archive(hdir_path)
+    if args.host_archive or args.multi_k:
+        if args.batch_size > 0 or args.checkpoint:
+            parser.error(f'Virus batches and checkpoints are not supported '
+                         'for host archives and multiple k-mer lengths.')
+    if not args.host_archive:
+        if not hdir_path.exists() or not hdir_path.is_dir():
+            parser.error(f'Input host directory does not exist: {hdir_path}')
+        if not any(f.is_file() for f in hdir_path.rglob('*')):
+            parser.error(f'Input host directory contains no files: {hdir_path}')
 
     args.v_path = v_path
     args.hdir_path = hdir_path
@@ -84,6 +154,300 @@ def validate_args(parser: argparse.ArgumentParser) -> argparse.Namespace:
     return args
 
 
+def is_host_archive(path: Path) -> bool:
+    """Checks if the file is a host archive created by utils/archiver."""
+    with open(path, 'rb') as fh:
+        return fh.read(8) == b'PHISTPHA'
+
+
+def read_fasta_batches(path: Path, batch_size: int) -> Iterator[str]:
+    """Streams records of a FASTA file (plain or gzip) in batches.
+
+    Yields:
+        FASTA text of consecutive batch_size records.
+    """
+    opener = gzip.open if path.suffix == '.gz' else open
+    with opener(path, 'rt') as fh:
+        batch = []
+        num_records = 0
+        for line in fh:
+            if line.startswith('>'):
+                if num_records == batch_size:
+                    yield ''.join(batch)
+                    batch = []
+                    num_records = 0
+                num_records += 1
+            batch.append(line)
+        if num_records:
+            yield ''.join(batch)
+
+
+def numa_wrap(cmd: list, args: argparse.Namespace) -> list:
+    """Runs a command with memory interleaved over NUMA nodes (if requested),
+    so that structures shared by threads on all sockets are not allocated
+    from a single node."""
+    if args.numactl:
+        return [args.numactl, '--interleave=all'] + cmd
+    return cmd
+
+
+def virus_db_key(vlst_path: Path, multisample: bool,
+                 args: argparse.Namespace) -> str:
+    """Hashes everything the virus database depends on: names and contents
+    of virus files, k-mer length, multi-FASTA mode, the tool version, and
+    the kmer-db binary (its size and modification time, as the database
+    format may change with kmer-db)."""
+    h = hashlib.sha256()
+    kmer_db = Path(kmer_exec).stat()
+    settings = {'version': __version__, 'k': args.k, 'multisample': multisample,
+                'kmer-db': [kmer_db.st_size, kmer_db.st_mtime_ns]}
+    h.update(json.dumps(settings, sort_keys=True).encode())
+    with open(vlst_path) as fh:
+        vfiles = [Path(line) for line in fh.read().splitlines() if line]
+    for f in vfiles:
+        # Samples are named after files, so names are a part of the key
+        h.update(f'\n{f.name}\n{f.stat().st_size}\n'.encode())
+        with open(f, 'rb') as fh:
+            for chunk in iter(lambda: fh.read(1 << 20), b''):
+                h.update(chunk)
+    return h.hexdigest()
+
+
+def build_virus_db(
+        vlst_path: Path,
+        db_path: Path,
+        multisample: bool,
+        check: bool,
+        args: argparse.Namespace) -> Path:
+    """Builds kmer-db database for viruses and returns its path. With a cache
+    directory, the database is stored there under a hash of the inputs and
+    a database built by an earlier run is used instead of building it."""
+    out_path = db_path
+    if args.cache_dir is not None:
+        cached_path = args.cache_dir / f'{virus_db_key(vlst_path, multisample, args)}.kdb'
+        if cached_path.exists():
+            print(f'Using cached virus database {cached_path}')
+            return cached_path
+        # Built under a temporary name, so that an interrupted build or
+        # concurrent runs never leave a partial database in the cache
+        out_path = cached_path.with_name(f'{cached_path.stem}.{os.getpid()}.tmp')
+
+    cmd = [
+        f'{kmer_exec}',
+        'build',
+        '-k',
+        f'{args.k}',
+        '-t',
+        f'{args.num_threads}',
+        f'{vlst_path}',
+        f'{out_path}',
+    ]
+    if multisample:
+        cmd.insert(6, '-multisample-fasta')
+    try:
+        proc = subprocess.run(numa_wrap(cmd, args), check=check)
+    except BaseException:
+        # Partial databases must not pile up in the cache
+        if out_path != db_path and out_path.exists():
+            out_path.unlink()
+        raise
+
+    if out_path == db_path:
+        return db_path
+    if proc.returncode != 0:
+        if out_path.exists():
+            out_path.unlink()
+        sys.exit(f'Kmer-db build failed with code {proc.returncode}')
+    out_path.replace(cached_path)
+    return cached_path
+
+
+def run_pipeline(
+        vlst_path: Path,
+        hlst_path: Path,
+        db_path: Path,
+        outtable_path: Path,
+        outpred_path: Path,
+        multisample: bool,
+        args: argparse.Namespace):
+    """Builds kmer-db database for viruses, compares it against hosts,
+    and predicts hosts."""
+    # Kmer-db build
+    vdb_path = build_virus_db(vlst_path, db_path, multisample, False, args)
+
+    # Kmer-db new2all
+    cmd = [
+        f'{kmer_exec}',
+        'new2all',
+        '-sparse',
+        '-t',
+        f'{args.num_threads}',
+        f'{vdb_path}',
+        f'{hlst_path}',
+        f'{outtable_path}',
+    ]
+    subprocess.run(numa_wrap(cmd, args))
+
+    # Cached databases are kept
+    if not args.keep_temp and vdb_path == db_path:
+        db_path.unlink()
+
+    # Postprocessing
+    cmd = [
+        f'{util_exec}',
+        f'{outtable_path}',
+        f'{outpred_path}',
+    ]
+    subprocess.run(cmd)
+
+
+def run_server_pipeline(
+        vlst_path: Path,
+        hosts_path: Path,
+        outpred_path: Path,
+        multisample: bool,
+        args: argparse.Namespace):
+    """Predicts hosts with the streaming mode of the server utility (no table
+    of common k-mers). Only phage k-mers are kept in memory, hosts are loaded
+    one by one. It is used for host archives, which kmer-db cannot read, and
+    for multiple k-mer lengths, which are extracted in a single scan of every
+    host. Hosts are given as an archive or a list of host files. With several
+    k-mer lengths, the server adds .k<length> before the output extension."""
+    cmd = [
+        f'{server_exec}',
+        '-k',
+        ','.join(str(k) for k in args.k_list),
+        '-t',
+        f'{args.num_threads}',
+        '-phages',
+        f'{vlst_path}',
+        '-output',
+        f'{outpred_path}',
+        f'{hosts_path}',
+    ]
+    if multisample:
+        cmd.insert(5, '-multisample-fasta')
+
+    proc = subprocess.run(numa_wrap(cmd, args))
+    if proc.returncode != 0:
+        sys.exit(f'Server failed with code {proc.returncode}')
+
+
+def open_checkpoint(ckpt_dir: Path, inputs: dict):
+    """Creates a checkpoint directory for given inputs. A checkpoint
+    left by a run with different inputs is discarded."""
+    manifest_path = ckpt_dir / 'manifest.json'
+    if manifest_path.exists():
+        with open(manifest_path) as fh:
+            if json.load(fh) != inputs:
+                print(f'Inputs changed - discarding checkpoint {ckpt_dir}')
+                shutil.rmtree(ckpt_dir)
+    ckpt_dir.mkdir(parents=True, exist_ok=True)
+    with open(manifest_path, 'w') as oh:
+        json.dump(inputs, oh)
+
+
+def run_checkpointed_pipeline(
+        vlst_path: Path,
+        hlst_path: Path,
+        db_path: Path,
+        outtable_path: Path,
+        outpred_path: Path,
+        multisample: bool,
+        inputs: dict,
+        ckpt_dir: Path,
+        args: argparse.Namespace):
+    """Runs the pipeline comparing hosts in batches. Completed steps are
+    recorded in ckpt_dir and skipped when the run is restarted with the
+    same inputs. Best hits are accumulated by phist in a state file after
+    every host batch (only the state is updated) and predictions are stored
+    once after the last batch."""
+    open_checkpoint(ckpt_dir, inputs)
+
+    # Kmer-db build (the marker is created only after a successful build)
+    build_done = ckpt_dir / 'build.done'
+    if build_done.exists() and db_path.exists():
+        print(f'Resuming: using virus database {db_path}')
+        vdb_path = db_path
+    else:
+        vdb_path = build_virus_db(vlst_path, db_path, multisample, True, args)
+        build_done.touch()
+
+    # host.list is line-based (paths may contain spaces)
+    with open(hlst_path) as fh:
+        hosts = [line for line in fh.read().splitlines() if line]
+    batches = [hosts[i:i + args.host_batch_size]
+               for i in range(0, len(hosts), args.host_batch_size)]
+
+    state_path = ckpt_dir / 'phist.state'
+    btable_paths = []
+    for i, batch in enumerate(batches):
+        btable_path = ckpt_dir / f'common_kmers.{i + 1}.csv'
+        btable_paths.append(btable_path)
+        table_done = ckpt_dir / f'common_kmers.{i + 1}.done'
+        if table_done.exists():
+            print(f'Resuming: host batch {i + 1}/{len(batches)} already compared')
+        else:
+            print(f'Comparing host batch {i + 1}/{len(batches)}...')
+            bhlst_path = ckpt_dir / 'host_batch.list'
+            with open(bhlst_path, 'w') as oh:
+                oh.write('\n'.join(batch) + '\n')
+
+            # Kmer-db new2all
+            cmd = [
+                f'{kmer_exec}',
+                'new2all',
+                '-sparse',
+                '-t',
+                f'{args.num_threads}',
+                f'{vdb_path}',
+                f'{bhlst_path}',
+                f'{btable_path}',
+            ]
+            subprocess.run(numa_wrap(cmd, args), check=True)
+            table_done.touch()
+            bhlst_path.unlink()
+
+        # Merge the batch into the best hits (merged tables are skipped)
+        cmd = [
+            f'{util_exec}',
+            '-state',
+            f'{state_path}',
+            '-state-only',
+            f'{btable_path}',
+        ]
+        subprocess.run(cmd, check=True)
+
+    # Predictions from the accumulated best hits
+    cmd = [
+        f'{util_exec}',
+        '-state',
+        f'{state_path}',
+        f'{outpred_path}',
+    ]
+    subprocess.run(cmd, check=True)
+
+    # Tables of consecutive batches have the same header - concatenate
+    # them into the table of all hosts
+    with open(outtable_path, 'w') as oh:
+        for i, btable_path in enumerate(btable_paths):
+            with open(btable_path) as fh:
+                if i > 0:
+                    fh.readline()
+                    fh.readline()
+                shutil.copyfileobj(fh, oh)
+
+    if not args.keep_temp:
+        if vdb_path == db_path:
+            db_path.unlink()
+        shutil.rmtree(ckpt_dir)
+
+
+def list_inputs(paths: list[Path]) -> list:
+    """Identifies input files by their paths, sizes, and modification times."""
+    return [[str(f), f.stat().st_size, f.stat().st_mtime_ns] for f in paths]
+
+
 if __name__ == '__main__':
     
     PHIST_DIR = Path(__file__).resolve().parent
@@ -91,9 +455,11 @@ if __name__ == '__main__':
     if platform.system() == "Windows":
         kmer_exec = PHIST_DIR.joinpath('kmer-db', 'src', 'x64', 'Release', 'kmer-db.exe')
         util_exec = PHIST_DIR.joinpath('utils', 'x64', 'Release', 'phist.exe')
+        server_exec = PHIST_DIR.joinpath('utils', 'x64', 'Release', 'server.exe')
     else:
         kmer_exec = PHIST_DIR.joinpath('kmer-db', 'kmer-db')
         util_exec = PHIST_DIR.joinpath('utils', 'phist')
+        server_exec = PHIST_DIR.joinpath('utils', 'server')
 
     parser = get_parser()
     args = validate_args(parser)
@@ -113,59 +479,115 @@ if __name__ == '__main__':
     db_path = out_dir / 'virus.kdb'
 
     # Create virus.lst
+    if v_path.is_dir():
+        vfiles = [f for f in sorted(v_path.rglob('*')) if f.is_file()]
+    else:
+        vfiles = [v_path]
     with open(vlst_path, 'w') as oh:
         if v_path.is_dir():
-            for f in sorted(v_path.rglob('*')):
-                if f.is_file():
-                    oh.write(f'{f}\n')
+            for f in vfiles:
+                oh.write(f'{f}\n')
         else:
             oh.write(f'{v_path}')
 
+    # Hosts stored in an archive are streamed by the server utility
+    if args.host_archive:
+        run_server_pipeline(vlst_path, hdir_path, args.outpred_path,
+                            v_path.is_file(), args)
+        if not args.keep_temp:
+            vlst_path.unlink()
+        sys.exit()
+
     # Create host.list.
+    hfiles = [f for f in sorted(hdir_path.rglob('*')) if f.is_file()]
     with open(hlst_path, 'w') as oh:
-        for f in sorted(hdir_path.rglob('*')):
-            if f.is_file():
-                oh.write(f"{f}\n")
+        for f in hfiles:
+            oh.write(f"{f}\n")
         oh.close()
 
-    # Kmer-db build
-    cmd = [
-        f'{kmer_exec}',
-        'build',
-        '-k',
-        f'{args.k}',
-        '-t',
-        f'{args.num_threads}',
-        f'{vlst_path}',
-        f'{db_path}',
-    ]
-    if v_path.is_file():
-        cmd.insert(6, '-multisample-fasta')
-    subprocess.run(cmd)
+    # Several k-mer lengths are handled by the server utility in one run
+    if args.multi_k:
+        run_server_pipeline(vlst_path, hlst_path, args.outpred_path,
+                            v_path.is_file(), args)
+        if not args.keep_temp:
+            vlst_path.unlink()
+            hlst_path.unlink()
+        sys.exit()
 
-    # Kmer-db new2all
-    cmd = [
-        f'{kmer_exec}',
-        'new2all',
-        '-sparse',
-        '-t',
-        f'{args.num_threads}',
-        f'{db_path}',
-        f'{hlst_path}',
-        f'{args.outtable_path}',
-    ]
-    subprocess.run(cmd)
+    # Checkpoints are valid only for the same inputs and settings
+    ckpt_root = out_dir / 'checkpoint'
+    inputs = {
+        'version': __version__,
+        'k': args.k,
+        'host_batch_size': args.host_batch_size,
+        'virus_batch_size': args.batch_size,
+        'viruses': list_inputs(vfiles) if args.checkpoint else [],
+        'hosts': list_inputs(hfiles) if args.checkpoint else [],
+    }
+
+    if args.batch_size == 0:
+        if args.checkpoint:
+            run_checkpointed_pipeline(vlst_path, hlst_path, db_path,
+                                      args.outtable_path, args.outpred_path,
+                                      v_path.is_file(), inputs, ckpt_root,
+                                      args)
+        else:
+            run_pipeline(vlst_path, hlst_path, db_path,
+                         args.outtable_path, args.outpred_path,
+                         v_path.is_file(), args)
+    else:
+        # Process virus records in batches and append predictions
+        vbatch_path = out_dir / 'virus_batch.fna'
+        with open(vlst_path, 'w') as oh:
+            oh.write(f'{vbatch_path}')
+
+        if args.checkpoint:
+            open_checkpoint(ckpt_root, inputs)
+
+        outtable = args.outtable_path
+        with open(args.outpred_path, 'w') as pred_oh:
+            for i, batch in enumerate(read_fasta_batches(v_path, args.batch_size)):
+                # Each batch has its own table of common k-mers
+                btable_path = outtable.with_name(f'{outtable.stem}.{i + 1}{outtable.suffix}')
+                bpred_path = out_dir / 'predictions_batch.csv'
+
+                # Predictions of completed batches are kept in the checkpoint
+                done_path = ckpt_root / f'predictions.{i + 1}.csv'
+                if args.checkpoint and done_path.exists():
+                    print(f'Resuming: virus batch {i + 1} already processed')
+                    shutil.copyfile(done_path, bpred_path)
+                else:
+                    print(f'Processing virus batch {i + 1}...')
+                    with open(vbatch_path, 'w') as oh:
+                        oh.write(batch)
+
+                    if args.checkpoint:
+                        run_checkpointed_pipeline(
+                            vlst_path, hlst_path, db_path, btable_path,
+                            bpred_path, True, dict(inputs, virus_batch=i),
+                            ckpt_root / f'batch{i + 1}', args)
+                        tmp_path = done_path.with_suffix('.tmp')
+                        shutil.copyfile(bpred_path, tmp_path)
+                        tmp_path.replace(done_path)
+                    else:
+                        run_pipeline(vlst_path, hlst_path, db_path,
+                                     btable_path, bpred_path, True, args)
+
+                with open(bpred_path) as fh:
+                    header = fh.readline()
+                    if i == 0:
+                        pred_oh.write(header)
+                    shutil.copyfileobj(fh, pred_oh)
+                pred_oh.flush()
+                bpred_path.unlink()
+
+        if not args.keep_temp:
+            if vbatch_path.exists():
+                vbatch_path.unlink()
+            if args.checkpoint:
+                shutil.rmtree(ckpt_root)
 
     # Remove temp files.
     if not args.keep_temp:
         vlst_path.unlink()
         hlst_path.unlink()
-        db_path.unlink()  
-    
-    # Postprocessing
-    cmd = [
-        f'{util_exec}',
-        f'{args.outtable_path}',
-        f'{args.outpred_path}',
-    ]
-    subprocess.run(cmd)
@@ -0,0 +1,642 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "../utils/input_file.h"
+#include "../utils/kmer_helper.h"
+#include "../utils/host_db.h"
+#include "../utils/prediction.h"
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+
+// *****************************************************************************************
+// Read-only one-dimensional array exposed through the buffer protocol, so that
+// numpy.asarray() or memoryview() access it without copying. The data is either owned
+// by the array (moved from a vector) or borrowed from another Python object kept alive.
+struct ArrayObject {
+	PyObject_HEAD
+	void* data;
+	Py_ssize_t size;			// number of items
+	Py_ssize_t itemSize;
+	const char* format;			// struct module format of items
+	void* storage;				// owned storage freed with release
+	void (*release)(void*);
+	PyObject* owner;			// owner of borrowed data
+};
+
+static PyTypeObject ArrayType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+template <class T>
+static PyObject* makeArray(std::vector<T>&& items, const char* format) {
+	ArrayObject* self = PyObject_New(ArrayObject, &ArrayType);
+	if (!self) {
+		return NULL;
+	}
+
+	std::vector<T>* storage = new std::vector<T>(std::move(items));
+	self->data = storage->data();
+	self->size = (Py_ssize_t)storage->size();
+	self->itemSize = sizeof(T);
+	self->format = format;
+	self->storage = storage;
+	self->release = [](void* p) { delete reinterpret_cast<std::vector<T>*>(p); };
+	self->owner = NULL;
+
+	return reinterpret_cast<PyObject*>(self);
+}
+
+static PyObject* makeBorrowedArray(void* data, Py_ssize_t size, Py_ssize_t itemSize, const char* format, PyObject* owner) {
+	ArrayObject* self = PyObject_New(ArrayObject, &ArrayType);
+	if (!self) {
+		return NULL;
+	}
+
+	self->data = data;
+	self->size = size;
+	self->itemSize = itemSize;
+	self->format = format;
+	self->storage = NULL;
+	self->release = NULL;
+	self->owner = owner;
+	Py_INCREF(owner);
+
+	return reinterpret_cast<PyObject*>(self);
+}
+
+static void Array_dealloc(ArrayObject* self) {
+	if (self->release) {
+		self->release(self->storage);
+	}
+	Py_XDECREF(self->owner);
+	PyObject_Del(self);
+}
+
+static int Array_getbuffer(ArrayObject* self, Py_buffer* view, int flags) {
+	if (flags & PyBUF_WRITABLE) {
+		PyErr_SetString(PyExc_BufferError, "array is read-only");
+		view->obj = NULL;
+		return -1;
+	}
+
+	view->obj = reinterpret_cast<PyObject*>(self);
+	Py_INCREF(self);
+	view->buf = self->data;
+	view->len = self->size * self->itemSize;
+	view->readonly = 1;
+	view->itemsize = self->itemSize;
+	view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(self->format) : NULL;
+	view->ndim = 1;
+	view->shape = (flags & PyBUF_ND) ? &self->size : NULL;
+	view->strides = (flags & PyBUF_STRIDES) ? &self->itemSize : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+
+	return 0;
+}
+
+static Py_ssize_t Array_length(ArrayObject* self) {
+	return self->size;
+}
+
+static PyObject* Array_item(ArrayObject* self, Py_ssize_t i) {
+	if (i < 0 || i >= self->size) {
+		PyErr_SetString(PyExc_IndexError, "array index out of range");
+		return NULL;
+	}
+
+	const char* item = reinterpret_cast<const char*>(self->data) + i * self->itemSize;
+	switch (self->format[0]) {
+	case 'Q': return PyLong_FromUnsignedLongLong(*reinterpret_cast<const uint64_t*>(item));
+	case 'I': return PyLong_FromUnsignedLong(*reinterpret_cast<const uint32_t*>(item));
+	case 'd': return PyFloat_FromDouble(*reinterpret_cast<const double*>(item));
+	default: return PyLong_FromLong(*reinterpret_cast<const uint8_t*>(item));
+	}
+}
+
+static PyBufferProcs Array_as_buffer = { (getbufferproc)Array_getbuffer, NULL };
+
+static PySequenceMethods Array_as_sequence = {
+	(lenfunc)Array_length,
+	NULL, NULL,
+	(ssizeargfunc)Array_item,
+};
+
+// *****************************************************************************************
+// Gets a contiguous buffer of any bytes-like object or an ASCII string.
+static bool getSequenceBuffer(PyObject* obj, Py_buffer& view, PyObject*& encoded) {
+	encoded = NULL;
+	if (PyUnicode_Check(obj)) {
+		encoded = PyUnicode_AsASCIIString(obj);
+		if (!encoded) {
+			return false;
+		}
+		obj = encoded;
+	}
+
+	if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS) != 0) {
+		Py_XDECREF(encoded);
+		return false;
+	}
+	return true;
+}
+
+static bool parseMode(const char* name, KmerMode& mode) {
+	if (strcmp(name, "canonical") == 0) {
+		mode = KmerMode::Canonical;
+	}
+	else if (strcmp(name, "forward") == 0) {
+		mode = KmerMode::Forward;
+	}
+	else if (strcmp(name, "reverse") == 0) {
+		mode = KmerMode::Reverse;
+	}
+	else {
+		PyErr_Format(PyExc_ValueError, "unknown k-mer mode: %s (canonical, forward, or reverse expected)", name);
+		return false;
+	}
+	return true;
+}
+
+
+// *****************************************************************************************
+// FastaFile wrapper
+struct FastaFileObject {
+	PyObject_HEAD
+	FastaFile* fasta;
+};
+
+static PyTypeObject FastaFileType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+static int FastaFile_init(FastaFileObject* self, PyObject* args, PyObject* kwds) {
+	static const char* kwlist[] = { "path", NULL };
+	PyObject* pathObj;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", const_cast<char**>(kwlist), PyUnicode_FSConverter, &pathObj)) {
+		return -1;
+	}
+	std::string path = PyBytes_AsString(pathObj);
+	Py_DECREF(pathObj);
+
+	// buffers exported by sequence() point into the loaded file - it must not be replaced
+	if (self->fasta) {
+		PyErr_SetString(PyExc_RuntimeError, "FastaFile is already initialized");
+		return -1;
+	}
+
+	FastaFile* fasta = new FastaFile();
+	bool ok;
+	Py_BEGIN_ALLOW_THREADS
+	ok = fasta->open(path);
+	Py_END_ALLOW_THREADS
+
+	if (!ok) {
+		delete fasta;
+		PyErr_Format(PyExc_OSError, "unable to open FASTA file: %s", path.c_str());
+		return -1;
+	}
+
+	// another initialization may have completed while the GIL was released
+	if (self->fasta) {
+		delete fasta;
+		PyErr_SetString(PyExc_RuntimeError, "FastaFile is already initialized");
+		return -1;
+	}
+	self->fasta = fasta;
+	return 0;
+}
+
+static void FastaFile_dealloc(FastaFileObject* self) {
+	delete self->fasta;
+	Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static bool FastaFile_check(FastaFileObject* self) {
+	if (!self->fasta) {
+		PyErr_SetString(PyExc_ValueError, "FastaFile is not initialized");
+		return false;
+	}
+	return true;
+}
+
+static Py_ssize_t FastaFile_length(FastaFileObject* self) {
+	return FastaFile_check(self) ? (Py_ssize_t)self->fasta->numSubsequences() : -1;
+}
+
+static PyObject* FastaFile_headers(FastaFileObject* self, void*) {
+	if (!FastaFile_check(self)) {
+		return NULL;
+	}
+
+	const auto& headers = self->fasta->getHeaders();
+	PyObject* list = PyList_New((Py_ssize_t)headers.size());
+	for (size_t i = 0; list && i < headers.size(); ++i) {
+		PyObject* h = PyUnicode_DecodeLatin1(headers[i], strlen(headers[i]), NULL);
+		if (!h) {
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, i, h);
+	}
+	return list;
+}
+
+static PyObject* FastaFile_lengths(FastaFileObject* self, void*) {
+	if (!FastaFile_check(self)) {
+		return NULL;
+	}
+
+	const auto& lengths = self->fasta->getLengths();
+	return makeArray(std::vector<uint64_t>(lengths.begin(), lengths.end()), "Q");
+}
+
+static PyObject* FastaFile_sequence(FastaFileObject* self, PyObject* arg) {
+	if (!FastaFile_check(self)) {
+		return NULL;
+	}
+
+	Py_ssize_t i = PyLong_AsSsize_t(arg);
+	if (i == -1 && PyErr_Occurred()) {
+		return NULL;
+	}
+	if (i < 0 || i >= (Py_ssize_t)self->fasta->numSubsequences()) {
+		PyErr_SetString(PyExc_IndexError, "record index out of range");
+		return NULL;
+	}
+
+	return makeBorrowedArray(
+		self->fasta->getSubsequences()[i], (Py_ssize_t)self->fasta->getLengths()[i], 1, "B", reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject* FastaFile_unique_kmers(FastaFileObject* self, PyObject* args, PyObject* kwds) {
+	static const char* kwlist[] = { "k", "first", "last", NULL };
+	unsigned int k;
+	Py_ssize_t first = 0, last = -1;
+	if (!FastaFile_check(self) || 
+		!PyArg_ParseTupleAndKeywords(args, kwds, "I|nn", const_cast<char**>(kwlist), &k, &first, &last)) {
+		return NULL;
+	}
+
+	Py_ssize_t n = (Py_ssize_t)self->fasta->numSubsequences();
+	if (last < 0) {
+		last = n;
+	}
+	if (k < 3 || k > 30 || first < 0 || first > last || last > n) {
+		PyErr_SetString(PyExc_ValueError, "invalid k-mer length or record range");
+		return NULL;
+	}
+
+	std::vector<kmer_t> kmers;
+	Py_BEGIN_ALLOW_THREADS
+	HostDatabase::extractUniqueKmers(*self->fasta, first, last, k, kmers);
+	Py_END_ALLOW_THREADS
+
+	return makeArray(std::move(kmers), "Q");
+}
+
+static PyMethodDef FastaFile_methods[] = {
+	{ "sequence", (PyCFunction)FastaFile_sequence, METH_O,
+		"sequence(i) -> array of bytes of the i-th record (no copy)" },
+	{ "unique_kmers", (PyCFunction)FastaFile_unique_kmers, METH_VARARGS | METH_KEYWORDS,
+		"unique_kmers(k, first=0, last=len) -> sorted distinct canonical k-mers of records [first, last)" },
+	{ NULL }
+};
+
+static PyGetSetDef FastaFile_getset[] = {
+	{ "headers", (getter)FastaFile_headers, NULL, "record headers (up to the first whitespace)", NULL },
+	{ "lengths", (getter)FastaFile_lengths, NULL, "record lengths (uint64 array)", NULL },
+	{ NULL }
+};
+
+static PySequenceMethods FastaFile_as_sequence = {
+	(lenfunc)FastaFile_length,
+};
+
+
+// *****************************************************************************************
+// Module functions
+static PyObject* phist_extract_kmers(PyObject*, PyObject* args, PyObject* kwds) {
+	static const char* kwlist[] = { "sequence", "k", "mode", NULL };
+	PyObject* seqObj;
+	unsigned int k;
+	const char* modeName = "canonical";
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OI|s", const_cast<char**>(kwlist), &seqObj, &k, &modeName)) {
+		return NULL;
+	}
+
+	KmerMode mode;
+	if (!parseMode(modeName, mode)) {
+		return NULL;
+	}
+	if (k < 3 || k > 30) {
+		PyErr_SetString(PyExc_ValueError, "k-mer length must be in range 3-30");
+		return NULL;
+	}
+
+	Py_buffer view;
+	PyObject* encoded;
+	if (!getSequenceBuffer(seqObj, view, encoded)) {
+		return NULL;
+	}
+
+	size_t len = (size_t)view.len;
+	std::vector<kmer_t> kmers(len >= k ? len - k + 1 : 0);
+	std::vector<uint32_t> positions(kmers.size());
+
+	Py_BEGIN_ALLOW_THREADS
+	if (kmers.size()) {
+		char* seq = reinterpret_cast<char*>(view.buf);
+		AlwaysPassFilter apf;
+		size_t count;
+		switch (mode) {
+		case KmerMode::Forward:
+			count = extract_kmers<KmerMode::Forward>(seq, len, k, apf, kmers.data(), positions.data());
+			break;
+		case KmerMode::Reverse:
+			count = extract_kmers<KmerMode::Reverse>(seq, len, k, apf, kmers.data(), positions.data());
+			break;
+		default:
+			count = extract_kmers<KmerMode::Canonical>(seq, len, k, apf, kmers.data(), positions.data());
+		}
+		kmers.resize(count);
+		positions.resize(count);
+	}
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&view);
+	Py_XDECREF(encoded);
+
+	PyObject* kmersArray = makeArray(std::move(kmers), "Q");
+	PyObject* positionsArray = makeArray(std::move(positions), "I");
+	if (!kmersArray || !positionsArray) {
+		Py_XDECREF(kmersArray);
+		Py_XDECREF(positionsArray);
+		return NULL;
+	}
+	return Py_BuildValue("(NN)", kmersArray, positionsArray);
+}
+
+static PyObject* phist_common_kmers(PyObject*, PyObject* args) {
+	PyObject *aObj, *bObj;
+	if (!PyArg_ParseTuple(args, "OO", &aObj, &bObj)) {
+		return NULL;
+	}
+
+	Py_buffer a, b;
+	if (PyObject_GetBuffer(aObj, &a, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+		return NULL;
+	}
+	if (PyObject_GetBuffer(bObj, &b, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+		PyBuffer_Release(&a);
+		return NULL;
+	}
+
+	if (a.itemsize != sizeof(kmer_t) || b.itemsize != sizeof(kmer_t)) {
+		PyBuffer_Release(&a);
+		PyBuffer_Release(&b);
+		PyErr_SetString(PyExc_ValueError, "arrays of 64-bit k-mers expected");
+		return NULL;
+	}
+
+	size_t count = 0;
+	Py_BEGIN_ALLOW_THREADS
+	const kmer_t* pa = reinterpret_cast<const kmer_t*>(a.buf);
+	const kmer_t* pb = reinterpret_cast<const kmer_t*>(b.buf);
+	const kmer_t* ea = pa + a.len / sizeof(kmer_t);
+	const kmer_t* eb = pb + b.len / sizeof(kmer_t);
+	while (pa != ea && pb != eb) {
+		if (*pa < *pb) {
+			++pa;
+		}
+		else if (*pb < *pa) {
+			++pb;
+		}
+		else {
+			++count;
+			++pa;
+			++pb;
+		}
+	}
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&a);
+	PyBuffer_Release(&b);
+	return PyLong_FromSize_t(count);
+}
+
+static PyObject* phist_pvalue(PyObject*, PyObject* args) {
+	unsigned int common, hostKmers, phageKmers, k;
+	if (!PyArg_ParseTuple(args, "IIII", &common, &hostKmers, &phageKmers, &k)) {
+		return NULL;
+	}
+	if (k < 3 || k > 30) {
+		PyErr_SetString(PyExc_ValueError, "k-mer length must be in range 3-30");
+		return NULL;
+	}
+	return PyFloat_FromDouble((double)computePValue(common, hostKmers, phageKmers, k));
+}
+
+// gets a buffer of uint32 values
+static bool getUInt32Buffer(PyObject* obj, Py_buffer& view, const char* name) {
+	if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+		return false;
+	}
+	char type = view.format ? view.format[strlen(view.format) - 1] : 'B';
+	if (view.itemsize != sizeof(uint32_t) || (type != 'I' && type != 'L')) {
+		PyBuffer_Release(&view);
+		PyErr_Format(PyExc_ValueError, "%s must be an array of unsigned 32-bit integers", name);
+		return false;
+	}
+	return true;
+}
+
+static PyObject* phist_best_hits(PyObject*, PyObject* args, PyObject* kwds) {
+	static const char* kwlist[] = { "phage_kmers", "host_kmers", "phage_ids", "host_ids", "common_kmers", "k", NULL };
+	PyObject* objs[5];
+	unsigned int k;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOOOI", const_cast<char**>(kwlist), 
+		&objs[0], &objs[1], &objs[2], &objs[3], &objs[4], &k)) {
+		return NULL;
+	}
+	if (k < 3 || k > 30) {
+		PyErr_SetString(PyExc_ValueError, "k-mer length must be in range 3-30");
+		return NULL;
+	}
+
+	Py_buffer views[5];
+	int numViews = 0;
+	for (; numViews < 5; ++numViews) {
+		if (!getUInt32Buffer(objs[numViews], views[numViews], kwlist[numViews])) {
+			break;
+		}
+	}
+
+	auto releaseAll = [&]() {
+		for (int i = 0; i < numViews; ++i) {
+			PyBuffer_Release(&views[i]);
+		}
+	};
+
+	if (numViews < 5) {
+		releaseAll();
+		return NULL;
+	}
+
+	const uint32_t* phageKmers = reinterpret_cast<const uint32_t*>(views[0].buf);
+	const uint32_t* hostKmers = reinterpret_cast<const uint32_t*>(views[1].buf);
+	const uint32_t* phageIds = reinterpret_cast<const uint32_t*>(views[2].buf);
+	const uint32_t* hostIds = reinterpret_cast<const uint32_t*>(views[3].buf);
+	const uint32_t* common = reinterpret_cast<const uint32_t*>(views[4].buf);
+	size_t numPhages = views[0].len / sizeof(uint32_t);
+	size_t numHosts = views[1].len / sizeof(uint32_t);
+	size_t numHits = views[2].len / sizeof(uint32_t);
+
+	if (views[3].len != views[2].len || views[4].len != views[2].len) {
+		releaseAll();
+		PyErr_SetString(PyExc_ValueError, "phage_ids, host_ids, and common_kmers must have equal lengths");
+		return NULL;
+	}
+
+	std::vector<uint32_t> outPhages, outHosts, outCommon;
+	std::vector<double> outPValues, outAdjPValues;
+	bool valid = true;
+
+	Py_BEGIN_ALLOW_THREADS
+	std::vector<Organism> hosts;
+	hosts.reserve(numHosts);
+	for (size_t i = 0; i < numHosts; ++i) {
+		hosts.emplace_back(std::string(), hostKmers[i]);
+	}
+
+	std::vector<Phage> phages;
+	phages.reserve(numPhages);
+	for (size_t i = 0; i < numPhages; ++i) {
+		phages.emplace_back(std::string(), phageKmers[i]);
+	}
+
+	// hits must be reported in the increasing order of hosts (as in phist)
+	std::vector<uint32_t> order(numHits);
+	for (uint32_t i = 0; i < numHits; ++i) {
+		order[i] = i;
+		valid &= phageIds[i] < numPhages && hostIds[i] < numHosts;
+	}
+
+	if (valid) {
+		std::stable_sort(order.begin(), order.end(), [hostIds](uint32_t a, uint32_t b) { return hostIds[a] < hostIds[b]; });
+		for (uint32_t i : order) {
+			phages[phageIds[i]].addHit(hostIds[i], common[i]);
+		}
+
+		// same ordering and p-values as in storePredictions
+		std::vector<Prediction> predictions;
+		for (size_t ph_id = 0; ph_id < phages.size(); ++ph_id) {
+			computePredictions(phages[ph_id], hosts, (uint32_t)numHosts, k, predictions);
+
+			for (const auto& p : predictions) {
+				outPhages.push_back((uint32_t)ph_id);
+				outHosts.push_back(p.host_id);
+				outCommon.push_back(p.common_kmers);
+				outPValues.push_back((double)p.pval);
+				outAdjPValues.push_back((double)p.adj_pval);
+			}
+		}
+	}
+	Py_END_ALLOW_THREADS
+
+	releaseAll();
+
+	if (!valid) {
+		PyErr_SetString(PyExc_IndexError, "phage or host identifier out of range");
+		return NULL;
+	}
+
+	return Py_BuildValue("(NNNNN)",
+		makeArray(std::move(outPhages), "I"),
+		makeArray(std::move(outHosts), "I"),
+		makeArray(std::move(outCommon), "I"),
+		makeArray(std::move(outPValues), "d"),
+		makeArray(std::move(outAdjPValues), "d"));
+}
+
+static PyMethodDef phist_methods[] = {
+	{ "extract_kmers", (PyCFunction)phist_extract_kmers, METH_VARARGS | METH_KEYWORDS,
+		"extract_kmers(sequence, k, mode='canonical') -> (kmers, positions)\n\n"
+		"Extracts k-mers (forward, reverse, or canonical) from a bytes-like object or a string.\n"
+		"K-mers containing non-ACGT symbols are skipped. Returns uint64 and uint32 arrays." },
+	{ "common_kmers", (PyCFunction)phist_common_kmers, METH_VARARGS,
+		"common_kmers(a, b) -> number of k-mers shared by two sorted arrays of distinct k-mers" },
+	{ "pvalue", (PyCFunction)phist_pvalue, METH_VARARGS,
+		"pvalue(common_kmers, host_kmers, phage_kmers, k) -> probability of sharing k-mers by chance" },
+	{ "best_hits", (PyCFunction)phist_best_hits, METH_VARARGS | METH_KEYWORDS,
+		"best_hits(phage_kmers, host_kmers, phage_ids, host_ids, common_kmers, k)\n"
+		"    -> (phage_ids, host_ids, common_kmers, pvalues, adj_pvalues)\n\n"
+		"Selects hosts sharing the largest number of k-mers with every phage (ties included) as\n"
+		"the phist utility does. Inputs are uint32 arrays: total k-mer counts of phages and hosts,\n"
+		"and sparse triples of common k-mer counts. P-values are adjusted by the number of hosts." },
+	{ NULL }
+};
+
+static PyModuleDef phist_module = {
+	PyModuleDef_HEAD_INIT,
+	"pyphist",
+	"In-process access to PHIST k-mer extraction and host prediction.\n\n"
+	"Arrays returned by the module support the buffer protocol (numpy.asarray() does not copy them).",
+	-1,
+	phist_methods
+};
+
+PyMODINIT_FUNC PyInit_pyphist(void) {
+	ArrayType.tp_name = "pyphist.Array";
+	ArrayType.tp_basicsize = sizeof(ArrayObject);
+	ArrayType.tp_dealloc = (destructor)Array_dealloc;
+	ArrayType.tp_as_buffer = &Array_as_buffer;
+	ArrayType.tp_as_sequence = &Array_as_sequence;
+	ArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+	ArrayType.tp_doc = "Read-only array supporting the buffer protocol";
+
+	FastaFileType.tp_name = "pyphist.FastaFile";
+	FastaFileType.tp_basicsize = sizeof(FastaFileObject);
+	FastaFileType.tp_dealloc = (destructor)FastaFile_dealloc;
+	FastaFileType.tp_init = (initproc)FastaFile_init;
+	FastaFileType.tp_new = PyType_GenericNew;
+	FastaFileType.tp_methods = FastaFile_methods;
+	FastaFileType.tp_getset = FastaFile_getset;
+	FastaFileType.tp_as_sequence = &FastaFile_as_sequence;
+	FastaFileType.tp_flags = Py_TPFLAGS_DEFAULT;
+	FastaFileType.tp_doc = "FastaFile(path) - FASTA file (gzipped or not) loaded into memory";
+
+	if (PyType_Ready(&ArrayType) < 0 || PyType_Ready(&FastaFileType) < 0) {
+		return NULL;
+	}
+
+	PyObject* m = PyModule_Create(&phist_module);
+	if (!m) {
+		return NULL;
+	}
+
+	Py_INCREF(&ArrayType);
+	PyModule_AddObject(m, "Array", reinterpret_cast<PyObject*>(&ArrayType));
+	Py_INCREF(&FastaFileType);
+	PyModule_AddObject(m, "FastaFile", reinterpret_cast<PyObject*>(&FastaFileType));
+
+	return m;
+}
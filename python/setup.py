@@ -0,0 +1,29 @@
+"""Python bindings of PHIST k-mer extraction and host prediction.
+
+Build in place with:
+    python3 setup.py build_ext --inplace
+"""
+
+from setuptools import setup, Extension
+
+module = Extension(
+    'pyphist',
+    sources=[
+        'phist_module.cpp',
+        '../utils/input_file.cpp',
+        '../utils/packed_sequence.cpp',
+        '../utils/fasta_loader.cpp',
+        '../utils/fasta_archive.cpp',
+        '../utils/host_db.cpp',
+    ],
+    extra_compile_args=['-O3', '-std=c++11', '-pthread'],
+    extra_link_args=['-pthread'],
+    libraries=['z'],
+)
+
+setup(
+    name='pyphist',
+    version='1.2.1',
+    description='In-process access to PHIST k-mer extraction and host prediction',
+    ext_modules=[module],
+)
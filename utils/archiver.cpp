@@ -0,0 +1,102 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_file.h"
+#include "fasta_loader.h"
+#include "fasta_archive.h"
+#include "params.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+
+	cout << "PHIST-Archiver utility 1.0.0" << endl
+		<< "A.Zielezinski, S. Deorowicz, A. Gudys (c) 2021" << endl << endl;
+
+	std::vector<std::string> params(argc - 1);
+	std::transform(argv + 1, argv + argc, params.begin(), [](char* s)->string { return s; });
+
+	int numThreads;
+	if (!findOption(params, "-t", numThreads)) {
+		numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+	}
+
+	if (params.size() != 2) {
+		cout << "USAGE:" << endl
+			<< "archiver [options] <hosts> <archive>" << endl << endl
+			<< "Parameters:" << endl
+			<< "\thosts - text file with host FASTA paths (one per line, gzipped or not)" << endl
+			<< "\tarchive - output host archive (2-bit sequences with an index of hosts)" << endl << endl
+			<< "Options:" << endl
+			<< "\t-t <threads> - number of threads loading hosts (number of cores by default)" << endl << endl
+			<< "Hosts are named after their files (as in kmer-db). The archive may be used instead" << endl
+			<< "of a host list by matcher and server utilities." << endl;
+		return 0;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	vector<string> hostPaths;
+	if (!loadList(params[0], hostPaths)) {
+		cout << "Unable to open host list: " << params[0] << endl;
+		return -1;
+	}
+
+	FastaArchiveWriter writer;
+	if (!writer.create(params[1])) {
+		cout << "Unable to create archive: " << params[1] << endl;
+		return -1;
+	}
+
+	// hosts are loaded and packed in the background and stored in the input order
+	FastaLoader loader(hostPaths, numThreads, 2 * numThreads, (size_t)1 << 30, true);
+	size_t host_id;
+	std::unique_ptr<FastaFile> fasta;
+	bool ok;
+
+	while (loader.pop(host_id, fasta, ok)) {
+		if (!ok) {
+			cout << endl << "Unable to open host file: " << hostPaths[host_id] << endl;
+			return -1;
+		}
+
+		if (!writer.add(getFileName(hostPaths[host_id]), *fasta)) {
+			cout << endl << "Unable to write archive: " << params[1] << endl;
+			return -1;
+		}
+
+		if ((host_id + 1) % 100 == 0) {
+			cout << "\r" << host_id + 1 << "..." << std::flush;
+		}
+	}
+
+	if (!writer.close()) {
+		cout << endl << "Unable to write archive: " << params[1] << endl;
+		return -1;
+	}
+
+	auto time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start);
+	cout << "\r" << hostPaths.size() << " hosts archived in " << time.count() << " seconds" << endl;
+
+	return 0;
+}
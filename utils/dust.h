@@ -0,0 +1,122 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "kmer_helper.h"
+#include "packed_sequence.h"
+
+#include <vector>
+#include <cstdint>
+
+#define DUST_WINDOW 64
+
+// *****************************************************************************************
+// DUST-style detection of low-complexity regions. Every window of DUST_WINDOW bases (with
+// no non-ACGT symbols) is scored as 10 * sum_t c_t * (c_t - 1) / 2 / (l - 1), where c_t is
+// the number of occurrences of triplet t and l is the number of triplets in the window.
+// Windows scoring above the threshold are masked (overlapping windows are merged).
+template <class SymbolReader>
+void find_low_complexity_regions(
+	SymbolReader& reader,
+	size_t sequenceLength,
+	int threshold,
+	std::vector<PackedSequence::Run>& regions) {
+
+	const uint32_t numTriplets = DUST_WINDOW - 2;
+
+	regions.clear();
+
+	uint32_t counts[64] = { 0 };
+	uint8_t queue[DUST_WINDOW];
+	uint32_t queueBegin = 0;
+	uint32_t queueSize = 0;
+	uint64_t sum = 0;
+	uint32_t validRun = 0;
+	uint8_t triplet = 0;
+
+	for (size_t i = 0; i < sequenceLength; ++i) {
+		char symb = reader.next();
+
+		if (symb < 0) {
+			// windows do not span non-ACGT symbols
+			std::fill_n(counts, 64, 0);
+			queueSize = 0;
+			sum = 0;
+			validRun = 0;
+			continue;
+		}
+
+		triplet = ((triplet << 2) | symb) & 63;
+		if (++validRun < 3) {
+			continue;
+		}
+
+		// add triplet ending at i
+		sum += counts[triplet]++;
+		queue[(queueBegin + queueSize++) % DUST_WINDOW] = triplet;
+
+		// remove triplet leaving the window
+		if (queueSize > numTriplets) {
+			sum -= --counts[queue[queueBegin]];
+			queueBegin = (queueBegin + 1) % DUST_WINDOW;
+			--queueSize;
+		}
+
+		if (queueSize == numTriplets && sum * 10 > (uint64_t)threshold * (numTriplets - 1)) {
+			uint32_t start = (uint32_t)(i + 1 - DUST_WINDOW);
+
+			if (regions.size() && regions.back().first + regions.back().second >= start) {
+				regions.back().second = (uint32_t)(i + 1 - regions.back().first);
+			}
+			else {
+				regions.emplace_back(start, DUST_WINDOW);
+			}
+		}
+	}
+}
+
+// *****************************************************************************************
+// Removes k-mers overlapping masked regions. Positions must be non-decreasing.
+// Returns the number of remaining k-mers.
+inline size_t remove_masked_kmers(
+	const std::vector<PackedSequence::Run>& regions,
+	uint32_t kmerLength,
+	kmer_t* kmers,
+	uint32_t* positions,
+	size_t count) {
+
+	auto region = regions.begin();
+	size_t out = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t pos = positions[i];
+
+		// skip regions ending before the k-mer
+		while (region != regions.end() && (uint64_t)region->first + region->second <= pos) {
+			++region;
+		}
+
+		if (region == regions.end() || region->first >= pos + kmerLength) {
+			kmers[out] = kmers[i];
+			positions[out] = positions[i];
+			++out;
+		}
+	}
+
+	return out;
+}
@@ -0,0 +1,290 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "fasta_archive.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char ARCHIVE_MAGIC[8] = { 'P', 'H', 'I', 'S', 'T', 'P', 'H', 'A' };
+static const uint64_t ARCHIVE_VERSION = 1;
+static const size_t ARCHIVE_HEADER_SIZE = 32;
+
+static uint64_t padded(uint64_t size) { return (size + 7) & ~(uint64_t)7; }
+
+// *****************************************************************************************
+//
+bool FastaArchive::isArchive(const std::string& path) {
+	char magic[sizeof(ARCHIVE_MAGIC)];
+	FILE* in = fopen(path.c_str(), "rb");
+	if (!in) {
+		return false;
+	}
+	bool ok = fread(magic, sizeof(magic), 1, in) == 1 && memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+	fclose(in);
+	return ok;
+}
+
+// *****************************************************************************************
+//
+bool FastaArchive::open(const std::string& path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	HANDLE handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!handle) {
+		return false;
+	}
+	data = reinterpret_cast<const char*>(MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0));
+	if (!data) {
+		CloseHandle(handle);
+		return false;
+	}
+	mapping = handle;
+	dataSize = (size_t)size.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		return false;
+	}
+	data = reinterpret_cast<const char*>(ptr);
+	dataSize = st.st_size;
+#endif
+
+	// header
+	const uint64_t* header = reinterpret_cast<const uint64_t*>(data);
+	if (dataSize < ARCHIVE_HEADER_SIZE || memcmp(data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || header[1] != ARCHIVE_VERSION) {
+		close();
+		return false;
+	}
+	uint64_t numHosts = header[2];
+	uint64_t pos = header[3];
+
+	// index (checks are written so that corrupted values cannot overflow)
+	for (uint64_t i = 0; i < numHosts; ++i) {
+		if (pos > dataSize || 3 * sizeof(uint64_t) > dataSize - pos) {
+			close();
+			return false;
+		}
+		const uint64_t* entry = reinterpret_cast<const uint64_t*>(data + pos);
+		uint64_t nameLen = entry[2];
+		pos += 3 * sizeof(uint64_t);
+
+		if (entry[0] > dataSize || entry[1] > dataSize - entry[0] || nameLen > dataSize - pos) {
+			close();
+			return false;
+		}
+
+		offsets.push_back(entry[0]);
+		sizes.push_back(entry[1]);
+		names.emplace_back(data + pos, nameLen);
+		pos += padded(nameLen);
+	}
+
+	return true;
+}
+
+// *****************************************************************************************
+//
+void FastaArchive::close() {
+	if (data) {
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle(reinterpret_cast<HANDLE>(mapping));
+#else
+		munmap(const_cast<char*>(data), dataSize);
+#endif
+	}
+
+	data = nullptr;
+	dataSize = 0;
+	mapping = nullptr;
+	names.clear();
+	offsets.clear();
+	sizes.clear();
+}
+
+// *****************************************************************************************
+//
+bool FastaArchive::load(size_t id, FastaFile& fasta) const {
+
+	const char* block = data + offsets[id];
+	const char* end = block + sizes[id];
+
+#ifndef _WIN32
+	// the block is read sequentially
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t alignedStart = offsets[id] & ~(uint64_t)(pageSize - 1);
+	madvise(const_cast<char*>(data) + alignedStart, offsets[id] + sizes[id] - alignedStart, MADV_WILLNEED);
+#endif
+
+	if (block + sizeof(uint64_t) > end) {
+		return false;
+	}
+	uint64_t numRecords = *reinterpret_cast<const uint64_t*>(block);
+	block += sizeof(uint64_t);
+
+	std::vector<PackedSequence> sequences(numRecords);
+	std::vector<std::string> headers(numRecords);
+
+	for (uint64_t i = 0; i < numRecords; ++i) {
+		if (block + 3 * sizeof(uint64_t) > end) {
+			return false;
+		}
+		const uint64_t* fields = reinterpret_cast<const uint64_t*>(block);
+		uint64_t length = fields[0];
+		uint64_t numRuns = fields[1];
+		uint64_t headerLen = fields[2];
+		block += 3 * sizeof(uint64_t);
+
+		uint64_t runsSize = numRuns * sizeof(PackedSequence::Run);
+		uint64_t wordsSize = (length + 31) / 32 * sizeof(uint64_t);
+		if ((uint64_t)(end - block) < padded(headerLen) + padded(runsSize) + wordsSize) {
+			return false;
+		}
+
+		headers[i].assign(block, headerLen);
+		block += padded(headerLen);
+
+		const PackedSequence::Run* runs = reinterpret_cast<const PackedSequence::Run*>(block);
+		block += padded(runsSize);
+
+		sequences[i].assign(reinterpret_cast<const uint64_t*>(block), length, runs, numRuns);
+		block += wordsSize;
+	}
+
+	fasta.setPacked(std::move(sequences), headers);
+	return true;
+}
+
+// *****************************************************************************************
+//
+bool FastaArchiveWriter::create(const std::string& path) {
+	file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+
+	// header is completed on close
+	char header[ARCHIVE_HEADER_SIZE] = { 0 };
+	offset = 0;
+	return write(header, sizeof(header));
+}
+
+// *****************************************************************************************
+//
+bool FastaArchiveWriter::add(const std::string& name, const FastaFile& fasta) {
+
+	const auto& sequences = fasta.getPackedSubsequences();
+	const auto& headers = fasta.getHeaders();
+
+	uint64_t start = offset;
+	bool ok = writeWord(sequences.size());
+
+	for (size_t i = 0; i < sequences.size(); ++i) {
+		const PackedSequence& ps = sequences[i];
+		const auto& runs = ps.getAmbiguousRuns();
+		size_t headerLen = strlen(headers[i]);
+
+		ok = ok
+			&& writeWord(ps.size())
+			&& writeWord(runs.size())
+			&& writeWord(headerLen)
+			&& writePadded(headers[i], headerLen)
+			&& writePadded(reinterpret_cast<const char*>(runs.data()), runs.size() * sizeof(PackedSequence::Run))
+			&& write(ps.data(), ps.numWords() * sizeof(uint64_t));
+	}
+
+	names.push_back(name);
+	offsets.push_back(start);
+	sizes.push_back(offset - start);
+
+	return ok;
+}
+
+// *****************************************************************************************
+//
+bool FastaArchiveWriter::close() {
+	if (!file) {
+		return false;
+	}
+
+	uint64_t indexOffset = offset;
+	bool ok = true;
+	for (size_t i = 0; i < names.size(); ++i) {
+		ok = ok
+			&& writeWord(offsets[i])
+			&& writeWord(sizes[i])
+			&& writeWord(names[i].size())
+			&& writePadded(names[i].c_str(), names[i].size());
+	}
+
+	uint64_t header[ARCHIVE_HEADER_SIZE / sizeof(uint64_t)];
+	memcpy(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+	header[1] = ARCHIVE_VERSION;
+	header[2] = names.size();
+	header[3] = indexOffset;
+
+	ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(header, sizeof(header), 1, file) == 1;
+	ok = (fclose(file) == 0) && ok;
+	file = nullptr;
+
+	return ok;
+}
+
+// *****************************************************************************************
+//
+bool FastaArchiveWriter::write(const void* buffer, size_t size) {
+	if (size && fwrite(buffer, size, 1, file) != 1) {
+		return false;
+	}
+	offset += size;
+	return true;
+}
+
+// *****************************************************************************************
+//
+bool FastaArchiveWriter::writePadded(const char* buffer, size_t size) {
+	static const char zeros[8] = { 0 };
+	return write(buffer, size) && write(zeros, padded(size) - size);
+}
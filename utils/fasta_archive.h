@@ -0,0 +1,96 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_file.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+// *****************************************************************************************
+// Archive of many host genomes in a single file, so that a host collection is read with
+// one open and one memory mapping instead of a file per host. Sequences are stored in
+// 2-bit representation. Layout (little-endian, all fields 64-bit, 8-byte aligned):
+//
+//	header:		magic "PHISTPHA", version, number of hosts, offset of the index
+//	host block:	number of records, then for every record: length, number of ambiguous
+//				runs, header length, header (padded), runs (start, length as 32-bit
+//				pairs), and the packed sequence words
+//	index:		for every host: offset and size of its block, name length, name (padded)
+class FastaArchive {
+public:
+	FastaArchive() : data(nullptr), dataSize(0), mapping(nullptr) {}
+	~FastaArchive() { close(); }
+
+	FastaArchive(const FastaArchive&) = delete;
+	FastaArchive& operator=(const FastaArchive&) = delete;
+
+	// checks the magic number of the file
+	static bool isArchive(const std::string& path);
+
+	bool open(const std::string& path);
+	void close();
+
+	size_t size() const { return names.size(); }
+	const std::vector<std::string>& getNames() const { return names; }
+
+	// loads records of the host (in packed form)
+	bool load(size_t id, FastaFile& fasta) const;
+
+protected:
+	const char* data;
+	size_t dataSize;
+	void* mapping; // platform handle of the mapping
+
+	std::vector<std::string> names;
+	std::vector<uint64_t> offsets;
+	std::vector<uint64_t> sizes;
+};
+
+// *****************************************************************************************
+// Creates an archive host by host.
+class FastaArchiveWriter {
+public:
+	FastaArchiveWriter() : file(nullptr), offset(0) {}
+	~FastaArchiveWriter() { if (file) { fclose(file); } }
+
+	FastaArchiveWriter(const FastaArchiveWriter&) = delete;
+	FastaArchiveWriter& operator=(const FastaArchiveWriter&) = delete;
+
+	bool create(const std::string& path);
+
+	// adds a host (the file must be packed)
+	bool add(const std::string& name, const FastaFile& fasta);
+
+	// stores the index and closes the archive
+	bool close();
+
+protected:
+	FILE* file;
+	uint64_t offset;
+
+	std::vector<std::string> names;
+	std::vector<uint64_t> offsets;
+	std::vector<uint64_t> sizes;
+
+	bool write(const void* buffer, size_t size);
+	bool writeWord(uint64_t value) { return write(&value, sizeof(value)); }
+	bool writePadded(const char* buffer, size_t size);
+};
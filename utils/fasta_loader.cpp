@@ -0,0 +1,161 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "fasta_loader.h"
+
+#include <algorithm>
+
+// *****************************************************************************************
+//
+FastaLoader::FastaLoader(
+	const std::vector<std::string>& paths,
+	int numThreads,
+	size_t maxQueuedFiles,
+	size_t maxQueuedBytes,
+	bool packed) :
+	paths(paths),
+	slots(paths.size()),
+	archive(nullptr),
+	maxQueuedFiles(std::max(maxQueuedFiles, (size_t)1)),
+	maxQueuedBytes(maxQueuedBytes),
+	packed(packed),
+	nextToLoad(0),
+	nextToPop(0),
+	queuedFiles(0),
+	queuedBytes(0),
+	cancelled(false) {
+
+	startWorkers(numThreads);
+}
+
+// *****************************************************************************************
+//
+FastaLoader::FastaLoader(
+	const FastaArchive& archive,
+	int numThreads,
+	size_t maxQueuedFiles,
+	size_t maxQueuedBytes) :
+	paths(archive.getNames()),
+	slots(archive.size()),
+	archive(&archive),
+	maxQueuedFiles(std::max(maxQueuedFiles, (size_t)1)),
+	maxQueuedBytes(maxQueuedBytes),
+	packed(true),
+	nextToLoad(0),
+	nextToPop(0),
+	queuedFiles(0),
+	queuedBytes(0),
+	cancelled(false) {
+
+	startWorkers(numThreads);
+}
+
+// *****************************************************************************************
+//
+void FastaLoader::startWorkers(int numThreads) {
+	numThreads = std::max(1, std::min(numThreads, (int)paths.size()));
+	for (int i = 0; i < numThreads; ++i) {
+		workers.emplace_back(&FastaLoader::workerLoop, this);
+	}
+}
+
+// *****************************************************************************************
+//
+FastaLoader::~FastaLoader() {
+	{
+		std::lock_guard<std::mutex> lck(mtx);
+		cancelled = true;
+	}
+	canLoad.notify_all();
+
+	for (auto& w : workers) {
+		w.join();
+	}
+}
+
+// *****************************************************************************************
+//
+bool FastaLoader::pop(size_t& id, std::unique_ptr<FastaFile>& file, bool& ok) {
+	std::unique_lock<std::mutex> lck(mtx);
+
+	if (nextToPop == slots.size()) {
+		return false;
+	}
+
+	// claim the slot before waiting so that concurrent consumers get different files
+	id = nextToPop++;
+	Slot& slot = slots[id];
+	canPop.wait(lck, [&slot]() { return slot.ready; });
+
+	ok = slot.ok;
+	file = std::move(slot.file);
+	--queuedFiles;
+	queuedBytes -= file->memoryUsage();
+
+	lck.unlock();
+	canLoad.notify_all();
+
+	return true;
+}
+
+// *****************************************************************************************
+//
+void FastaLoader::workerLoop() {
+
+	for (;;) {
+		std::unique_lock<std::mutex> lck(mtx);
+
+		// start a new file only if there is room in the queue (always when the queue is empty)
+		canLoad.wait(lck, [this]() {
+			return cancelled
+				|| nextToLoad == slots.size()
+				|| queuedFiles == 0
+				|| (queuedFiles < maxQueuedFiles && queuedBytes < maxQueuedBytes);
+		});
+
+		if (cancelled || nextToLoad == slots.size()) {
+			break;
+		}
+
+		size_t id = nextToLoad++;
+		++queuedFiles;
+		lck.unlock();
+
+		std::unique_ptr<FastaFile> file(new FastaFile());
+		bool ok;
+		if (archive) {
+			ok = archive->load(id, *file);
+		}
+		else {
+			ok = file->open(paths[id]);
+			if (ok && packed) {
+				file->pack();
+			}
+		}
+		size_t bytes = file->memoryUsage();
+
+		lck.lock();
+		slots[id].file = std::move(file);
+		slots[id].ok = ok;
+		slots[id].ready = true;
+		queuedBytes += bytes;
+		lck.unlock();
+
+		canPop.notify_all();
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_file.h"
+#include "fasta_archive.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// *****************************************************************************************
+// Loads FASTA files in background threads (reading, decompression, parsing) so that
+// the next genomes are ready when the consumers finish with the current ones.
+// Files are handed out in the input order. At most maxQueuedFiles files are kept
+// loaded or in flight, and no new file is started when loaded files occupy
+// maxQueuedBytes or more (unless nothing is queued). Files may be converted to 2-bit
+// representation by the loading threads.
+class FastaLoader {
+public:
+	FastaLoader(
+		const std::vector<std::string>& paths,
+		int numThreads,
+		size_t maxQueuedFiles,
+		size_t maxQueuedBytes,
+		bool packed = false);
+
+	// loads hosts of an archive (identified by names, always packed)
+	FastaLoader(
+		const FastaArchive& archive,
+		int numThreads,
+		size_t maxQueuedFiles,
+		size_t maxQueuedBytes);
+
+	~FastaLoader();
+
+	// Gets the next file in the input order (blocks until it is loaded).
+	// Returns false when all files have been handed out. Failed loads are
+	// signalled by ok set to false.
+	bool pop(size_t& id, std::unique_ptr<FastaFile>& file, bool& ok);
+
+	size_t size() const { return paths.size(); }
+	const std::string& getPath(size_t id) const { return paths[id]; }
+
+protected:
+	struct Slot {
+		std::unique_ptr<FastaFile> file;
+		bool ready;
+		bool ok;
+
+		Slot() : ready(false), ok(false) {}
+	};
+
+	std::vector<std::string> paths;
+	std::vector<Slot> slots;
+	const FastaArchive* archive;
+
+	size_t maxQueuedFiles;
+	size_t maxQueuedBytes;
+	bool packed;
+
+	size_t nextToLoad;
+	size_t nextToPop;
+	size_t queuedFiles;		// loaded or in flight, not yet handed out
+	size_t queuedBytes;
+	bool cancelled;
+
+	std::mutex mtx;
+	std::condition_variable canLoad;
+	std::condition_variable canPop;
+	std::vector<std::thread> workers;
+
+	void startWorkers(int numThreads);
+	void workerLoop();
+};
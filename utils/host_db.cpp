@@ -0,0 +1,246 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "host_db.h"
+#include "fasta_loader.h"
+#include "params.h"
+
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <iostream>
+
+// *****************************************************************************************
+//
+void KmerDatabase::extractUniqueKmers(
+	const FastaFile& fasta,
+	size_t first,
+	size_t last,
+	uint32_t k,
+	std::vector<kmer_t>& kmers) {
+
+	size_t total = 0;
+	for (size_t i = first; i < last; ++i) {
+		if (fasta.getLengths()[i] >= k) {
+			total += fasta.getLengths()[i] - k + 1;
+		}
+	}
+
+	kmers.resize(total);
+	AlwaysPassFilter apf;
+	size_t count = 0;
+
+	for (size_t i = first; i < last; ++i) {
+		if (fasta.getLengths()[i] < k) {
+			continue;
+		}
+
+		if (fasta.isPacked()) {
+			count += extract_kmers<KmerMode::Canonical, AlwaysPassFilter>(
+				fasta.getPackedSubsequences()[i], k, apf, kmers.data() + count, nullptr);
+		}
+		else {
+			count += extract_kmers<KmerMode::Canonical, AlwaysPassFilter>(
+				fasta.getSubsequences()[i],
+				fasta.getLengths()[i],
+				k,
+				apf,
+				kmers.data() + count,
+				nullptr);
+		}
+	}
+
+	kmers.resize(count);
+	std::sort(kmers.begin(), kmers.end());
+	kmers.erase(std::unique(kmers.begin(), kmers.end()), kmers.end());
+}
+
+// *****************************************************************************************
+//
+void KmerDatabase::extractUniqueKmers(
+	const FastaFile& fasta,
+	size_t first,
+	size_t last,
+	const std::vector<uint32_t>& ks,
+	std::vector<std::vector<kmer_t>>& kmers) {
+
+	kmers.resize(ks.size());
+	for (auto& v : kmers) {
+		v.clear();
+	}
+
+	for (size_t i = first; i < last; ++i) {
+		if (fasta.isPacked()) {
+			extract_kmers_multi<KmerMode::Canonical>(fasta.getPackedSubsequences()[i], ks, kmers.data());
+		}
+		else {
+			extract_kmers_multi<KmerMode::Canonical>(fasta.getSubsequences()[i], fasta.getLengths()[i], ks, kmers.data());
+		}
+	}
+
+	for (auto& v : kmers) {
+		std::sort(v.begin(), v.end());
+		v.erase(std::unique(v.begin(), v.end()), v.end());
+	}
+}
+
+// *****************************************************************************************
+//
+bool HostDatabase::build(const std::vector<std::string>& paths, int numThreads) {
+	FastaLoader loader(paths, std::max(1, numThreads / 2), 2 * numThreads, (size_t)1 << 30);
+	return build(loader, numThreads);
+}
+
+// *****************************************************************************************
+//
+bool HostDatabase::build(const FastaArchive& archive, int numThreads) {
+	FastaLoader loader(archive, std::max(1, numThreads / 2), 2 * numThreads, (size_t)1 << 30);
+	return build(loader, numThreads);
+}
+
+// *****************************************************************************************
+//
+bool HostDatabase::build(FastaLoader& loader, int numThreads) {
+
+	organisms.assign(loader.size(), Organism("", 0));
+
+	std::vector<Entry> entries;
+	std::mutex mtx;
+	bool ok = true;
+
+	std::vector<std::thread> workers;
+	for (int tid = 0; tid < std::max(1, numThreads); ++tid) {
+		workers.emplace_back([&]() {
+			size_t host_id;
+			std::unique_ptr<FastaFile> fasta;
+			bool loaded;
+			std::vector<kmer_t> hostKmers;
+
+			while (loader.pop(host_id, fasta, loaded)) {
+				if (loaded) {
+					extractUniqueKmers(*fasta, 0, fasta->numSubsequences(), k, hostKmers);
+				}
+				fasta.reset();
+
+				std::lock_guard<std::mutex> lck(mtx);
+				if (!loaded) {
+					std::cerr << "Unable to open host file: " << loader.getPath(host_id) << std::endl;
+					ok = false;
+					continue;
+				}
+
+				organisms[host_id] = Organism(getFileName(loader.getPath(host_id)), (uint32_t)hostKmers.size());
+				for (kmer_t kmer : hostKmers) {
+					entries.push_back(Entry{ kmer, (uint32_t)host_id });
+				}
+			}
+		});
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	if (!ok) {
+		return false;
+	}
+
+	buildIndex(entries);
+	return true;
+}
+
+// *****************************************************************************************
+//
+void KmerDatabase::build(std::vector<Organism>&& organisms, std::vector<std::vector<kmer_t>>& organismKmers) {
+	this->organisms = std::move(organisms);
+
+	size_t total = 0;
+	for (const auto& v : organismKmers) {
+		total += v.size();
+	}
+
+	std::vector<Entry> entries;
+	entries.reserve(total);
+	for (size_t id = 0; id < organismKmers.size(); ++id) {
+		for (kmer_t kmer : organismKmers[id]) {
+			entries.push_back(Entry{ kmer, (uint32_t)id });
+		}
+		std::vector<kmer_t>().swap(organismKmers[id]);
+	}
+
+	buildIndex(entries);
+}
+
+// *****************************************************************************************
+//
+void KmerDatabase::buildIndex(std::vector<Entry>& entries) {
+	std::sort(entries.begin(), entries.end());
+
+	kmers.clear();
+	offsets.clear();
+	ids.resize(entries.size());
+
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (i == 0 || entries[i].kmer != entries[i - 1].kmer) {
+			kmers.push_back(entries[i].kmer);
+			offsets.push_back(i);
+		}
+		ids[i] = entries[i].id;
+	}
+	offsets.push_back(entries.size());
+
+	std::vector<Entry>().swap(entries);
+}
+
+// *****************************************************************************************
+//
+void KmerDatabase::query(
+	const std::vector<kmer_t>& queryKmers,
+	std::vector<uint32_t>& counters,
+	std::vector<Hit>& hits) const {
+
+	counters.resize(organisms.size(), 0);
+	std::vector<uint32_t> touched;
+
+	// query k-mers are sorted - search only after the previous position
+	auto it = kmers.begin();
+	for (kmer_t kmer : queryKmers) {
+		it = std::lower_bound(it, kmers.end(), kmer);
+		if (it == kmers.end()) {
+			break;
+		}
+
+		if (*it == kmer) {
+			size_t id = it - kmers.begin();
+			for (uint64_t j = offsets[id]; j < offsets[id + 1]; ++j) {
+				uint32_t org_id = ids[j];
+				if (counters[org_id]++ == 0) {
+					touched.push_back(org_id);
+				}
+			}
+		}
+	}
+
+	std::sort(touched.begin(), touched.end());
+
+	hits.clear();
+	for (uint32_t org_id : touched) {
+		hits.emplace_back(org_id, counters[org_id]);
+		counters[org_id] = 0;
+	}
+}
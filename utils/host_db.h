@@ -0,0 +1,105 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_file.h"
+#include "fasta_archive.h"
+#include "kmer_helper.h"
+#include "prediction.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+class FastaLoader;
+
+// *****************************************************************************************
+// In-memory inverted index of canonical k-mers of organisms. For every distinct k-mer it 
+// stores identifiers of organisms containing it, which allows counting k-mers shared by 
+// a query with all organisms at the cost proportional to the query size.
+class KmerDatabase {
+public:
+	KmerDatabase(uint32_t k) : k(k) {}
+
+	uint32_t getK() const { return k; }
+	const std::vector<Organism>& getOrganisms() const { return organisms; }
+	size_t numKmers() const { return kmers.size(); }
+
+	// indexes sorted, distinct k-mers of the given organisms (the k-mer sets are released)
+	void build(std::vector<Organism>&& organisms, std::vector<std::vector<kmer_t>>& organismKmers);
+
+	// counts k-mers shared between the query (sorted, distinct k-mers) and organisms;
+	// hits are reported in the increasing order of identifiers, organisms with no
+	// common k-mers are omitted; counters is a scratch buffer reused between calls
+	void query(
+		const std::vector<kmer_t>& queryKmers,
+		std::vector<uint32_t>& counters,
+		std::vector<Hit>& hits) const;
+
+	// extracts sorted, distinct canonical k-mers from the given range of subsequences
+	static void extractUniqueKmers(
+		const FastaFile& fasta,
+		size_t first,
+		size_t last,
+		uint32_t k,
+		std::vector<kmer_t>& kmers);
+
+	// extracts k-mers of several lengths in a single scan (kmers[j] for length ks[j])
+	static void extractUniqueKmers(
+		const FastaFile& fasta,
+		size_t first,
+		size_t last,
+		const std::vector<uint32_t>& ks,
+		std::vector<std::vector<kmer_t>>& kmers);
+
+protected:
+	struct Entry {
+		kmer_t kmer;
+		uint32_t id;
+
+		bool operator<(const Entry& e) const { return kmer < e.kmer || (kmer == e.kmer && id < e.id); }
+	};
+
+	uint32_t k;
+	std::vector<Organism> organisms;
+
+	std::vector<kmer_t> kmers;		// sorted distinct k-mers
+	std::vector<uint64_t> offsets;	// organisms of kmers[i] are in ids[offsets[i]...offsets[i + 1] - 1]
+	std::vector<uint32_t> ids;
+
+	// builds the index from entries (released afterwards)
+	void buildIndex(std::vector<Entry>& entries);
+};
+
+// *****************************************************************************************
+// Database of host k-mers kept in memory by the server.
+class HostDatabase : public KmerDatabase {
+public:
+	HostDatabase(uint32_t k) : KmerDatabase(k) {}
+
+	const std::vector<Organism>& getHosts() const { return organisms; }
+
+	// loads host FASTA files (one host per file) in the given number of threads
+	bool build(const std::vector<std::string>& paths, int numThreads);
+
+	// loads all hosts of an archive
+	bool build(const FastaArchive& archive, int numThreads);
+
+protected:
+	bool build(FastaLoader& loader, int numThreads);
+};
@@ -38,7 +38,7 @@ Authors: Sebastian Deorowicz, Adam Gudys, Maciej Dlugosz, Marek Kokot, Agnieszka
 	
 	// try to open without adding extension
 	in = fopen(filename.c_str(), "rb");
-	isGzipped = filename.substr(filename.length() - 3) == ".gz";
+	isGzipped = filename.length() > 3 && filename.substr(filename.length() - 3) == ".gz";
 	
 	if (!in) {
 		return status;
@@ -65,6 +65,11 @@ Authors: Sebastian Deorowicz, Adam Gudys, Maciej Dlugosz, Marek Kokot, Agnieszka
 		if (!status) {
 			return status;
 		}
+
+		// compressed contents are no longer needed
+		free(rawData);
+		rawData = data;
+		rawSize = totalLen;
 	}
 	else {
 		data = rawData;
@@ -76,6 +81,98 @@ Authors: Sebastian Deorowicz, Adam Gudys, Maciej Dlugosz, Marek Kokot, Agnieszka
 	return status;
 }
 
+ // *****************************************************************************************
+ //
+bool FastaFile::parse(const char* data, size_t size) {
+	
+	close();
+	
+	rawData = reinterpret_cast<char*>(malloc(size + 1));
+	memcpy(rawData, data, size);
+	rawData[size] = 0; // add null termination 
+	rawSize = size;
+	totalLen = size;
+
+	// no records
+	if (!memchr(rawData, '>', size)) {
+		status = false;
+		return status;
+	}
+
+	status = extractSubsequences(rawData, totalLen, subsequences, lengths, headers);
+	return status;
+}
+
+ // *****************************************************************************************
+ //
+size_t FastaFile::memoryUsage() const {
+	if (!packed) {
+		return rawData ? rawSize + 1 : 0;
+	}
+
+	size_t total = headerData.size();
+	for (const auto& ps : packedSubsequences) {
+		total += ps.memoryUsage();
+	}
+	return total;
+}
+
+ // *****************************************************************************************
+ //
+void FastaFile::pack() {
+	if (packed || !rawData) {
+		return;
+	}
+
+	packedSubsequences.resize(subsequences.size());
+	size_t headersLen = 0;
+	for (size_t i = 0; i < subsequences.size(); ++i) {
+		packedSubsequences[i].pack(subsequences[i], lengths[i]);
+		headersLen += strlen(headers[i]) + 1;
+	}
+
+	// move headers out of the text buffer
+	headerData.resize(headersLen);
+	char* ptr = headerData.data();
+	for (auto& h : headers) {
+		size_t len = strlen(h) + 1;
+		memcpy(ptr, h, len);
+		h = ptr;
+		ptr += len;
+	}
+
+	subsequences.clear();
+	free(rawData);
+	rawData = nullptr;
+	rawSize = 0;
+	packed = true;
+}
+
+ // *****************************************************************************************
+ //
+void FastaFile::setPacked(std::vector<PackedSequence>&& sequences, const std::vector<std::string>& names) {
+	close();
+
+	packedSubsequences = std::move(sequences);
+	
+	size_t headersLen = 0;
+	for (size_t i = 0; i < packedSubsequences.size(); ++i) {
+		lengths.push_back(packedSubsequences[i].size());
+		headersLen += names[i].size() + 1;
+	}
+
+	headerData.resize(headersLen);
+	char* ptr = headerData.data();
+	for (const auto& name : names) {
+		memcpy(ptr, name.c_str(), name.size() + 1);
+		headers.push_back(ptr);
+		ptr += name.size() + 1;
+	}
+
+	status = true;
+	packed = true;
+}
+
  // *****************************************************************************************
  //
  /*
@@ -252,7 +349,96 @@ bool FastaFile::extractSubsequences(
 }
 
 
+// *****************************************************************************************
+//
+bool FastaReader::open(const std::string& filename) {
+	close();
+
+	gzFile in = gzopen(filename.c_str(), "rb");
+	if (!in) {
+		return false;
+	}
+
+	gzbuffer(in, CHUNK_SIZE);
+	file = in;
+	eof = false;
+	return true;
+}
+
+// *****************************************************************************************
+//
+void FastaReader::close() {
+	if (file) {
+		gzclose(reinterpret_cast<gzFile>(file));
+		file = nullptr;
+	}
+	buffer.clear();
+	eof = true;
+}
+
+// *****************************************************************************************
+//
+bool FastaReader::fill() {
+	if (eof) {
+		return false;
+	}
 
+	size_t prevSize = buffer.size();
+	buffer.resize(prevSize + CHUNK_SIZE);
+	int n = gzread(reinterpret_cast<gzFile>(file), &buffer[prevSize], CHUNK_SIZE);
+	
+	if (n <= 0) {
+		n = 0;
+		eof = true;
+	}
+	buffer.resize(prevSize + n);
 
+	return n > 0;
+}
+
+// *****************************************************************************************
+//
+bool FastaReader::readBatch(size_t maxRecords, size_t maxBytes, FastaFile& batch) {
+
+	// skip everything before the first record
+	size_t begin;
+	while ((begin = buffer.find('>')) == std::string::npos) {
+		buffer.clear();
+		if (!fill()) {
+			return false;
+		}
+	}
+	buffer.erase(0, begin);
 
+	size_t numRecords = 1;
+	size_t recordStart = 0;
+	size_t scanned = 0;
+	size_t end = std::string::npos;
 
+	while (end == std::string::npos) {
+		// look for the beginning of the next record
+		size_t next = buffer.find("\n>", std::max(recordStart, scanned));
+		
+		if (next != std::string::npos) {
+			recordStart = next + 1;
+			if (numRecords == maxRecords || recordStart >= maxBytes) {
+				end = recordStart;
+			}
+			else {
+				++numRecords;
+			}
+		}
+		else {
+			// newline may be the last character of the buffer
+			scanned = buffer.size() ? buffer.size() - 1 : 0;
+			if (!fill()) {
+				end = buffer.size();
+			}
+		}
+	}
+
+	bool ok = batch.parse(buffer.data(), end);
+	buffer.erase(0, end);
+
+	return ok;
+}
@@ -11,8 +11,10 @@ Authors: Sebastian Deorowicz, Adam Gudys, Maciej Dlugosz, Marek Kokot, Agnieszka
 #include <fstream>
 #include <string>
 #include <cassert>
+#include <cstdlib>
 
 #include "kmer_helper.h"
+#include "packed_sequence.h"
 
 // *****************************************************************************************
 //
@@ -25,15 +27,45 @@ public:
 	const std::vector<size_t>& getLengths() const { return lengths; }
 	const std::vector<char*>& getHeaders() const { return headers; }
 
-	size_t numSubsequences() const { return subsequences.size(); }
+	const std::vector<PackedSequence>& getPackedSubsequences() const { return packedSubsequences; }
 
+	size_t numSubsequences() const { return headers.size(); }
+	bool isPacked() const { return packed; }
 
-	FastaFile() : rawSize(0), rawData(nullptr), totalLen(0), status(true), isGzipped(false) {}
-	~FastaFile() { delete [] rawData;  }
+	// number of bytes occupied by the sequences and headers
+	size_t memoryUsage() const;
+
+
+	FastaFile() : rawSize(0), rawData(nullptr), totalLen(0), status(true), isGzipped(false), packed(false) {}
+	~FastaFile() { close();  }
+
+	FastaFile(const FastaFile&) = delete;
+	FastaFile& operator=(const FastaFile&) = delete;
 
 	bool open(const std::string& filename);
+
+	// parses FASTA contents from memory (the data is copied)
+	bool parse(const char* data, size_t size);
+
+	// converts subsequences to 2-bit representation and releases the text (only
+	// packed subsequences, lengths, and headers are available afterwards)
+	void pack();
+
+	// fills the file with already packed subsequences (e.g. read from an archive)
+	void setPacked(std::vector<PackedSequence>&& sequences, const std::vector<std::string>& names);
 	
-	bool close() { delete[] rawData; return true; }
+	bool close() { 
+		free(rawData); 
+		rawData = nullptr;
+		rawSize = 0;
+		subsequences.clear();
+		lengths.clear();
+		headers.clear();
+		packedSubsequences.clear();
+		headerData.clear();
+		packed = false;
+		return true; 
+	}
 
 
 protected:
@@ -42,11 +74,15 @@ protected:
 	size_t totalLen;
 	bool status;
 	bool isGzipped;
+	bool packed;
 
 	std::vector<char*> subsequences;
 	std::vector<size_t> lengths;
 	std::vector<char*> headers;
 
+	std::vector<PackedSequence> packedSubsequences;
+	std::vector<char> headerData; // headers of a packed file
+
 	bool unzip(char* compressedData, size_t compressedSize, char*&outData, size_t &outSize);
 	
 	bool extractSubsequences(
@@ -58,3 +94,32 @@ protected:
 
 	
 };
+
+
+// *****************************************************************************************
+// Reads FASTA files (gzipped or not) in batches of records, so that only a bounded part
+// of the file is kept in memory.
+class FastaReader {
+public:
+	FastaReader() : file(nullptr), eof(true) {}
+	~FastaReader() { close(); }
+
+	FastaReader(const FastaReader&) = delete;
+	FastaReader& operator=(const FastaReader&) = delete;
+
+	bool open(const std::string& filename);
+	void close();
+
+	// Reads the next batch of at most maxRecords records; the batch is also closed after
+	// the record which exceeds maxBytes of FASTA text. Returns false when no records are left.
+	bool readBatch(size_t maxRecords, size_t maxBytes, FastaFile& batch);
+
+protected:
+	static const size_t CHUNK_SIZE = 16 << 20;
+
+	void* file; // gzFile (plain files are read transparently)
+	std::string buffer; // data read from the file but not consumed yet
+	bool eof;
+
+	bool fill();
+};
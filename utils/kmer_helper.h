@@ -1,6 +1,10 @@
 #pragma once
 #include <cstdint>
 #include <unordered_set>
+#include <algorithm>
+#include <vector>
+
+#include "packed_sequence.h"
 
 #define SUFFIX_LEN 16
 
@@ -24,40 +28,98 @@ template <>
 inline kmer_t select_kmer<KmerMode::Canonical>(kmer_t fov, kmer_t rev) { return (fov < rev) ? fov : rev; }
 
 
+// 2-bit encoding of nucleotides (negative for non-ACGT symbols)
+inline const char* get_symbol_map() {
+	static const char* map = []() {
+		static char _map[256];
+		std::fill_n(_map, 256, -1);
+		_map['a'] = _map['A'] = 0;
+		_map['c'] = _map['C'] = 1;
+		_map['g'] = _map['G'] = 2;
+		_map['t'] = _map['T'] = 3;
+		return _map;
+	}();
+
+	return map;
+}
+
+
+// symbol readers - sequential access to 2-bit codes of the sequence
+class CharSymbolReader {
+	const char* map;
+	const char* ptr;
+public:
+	CharSymbolReader(const char* sequence) : map(get_symbol_map()), ptr(sequence) {}
+
+	char next() { return map[static_cast<unsigned char>(*ptr++)]; }
+};
+
+class PackedSymbolReader {
+	const uint64_t* words;
+	const PackedSequence::Run* run;
+	const PackedSequence::Run* runsEnd;
+	size_t pos;
+	uint64_t word;
+public:
+	PackedSymbolReader(const PackedSequence& sequence) : 
+		words(sequence.data()), 
+		run(sequence.getAmbiguousRuns().data()), 
+		runsEnd(sequence.getAmbiguousRuns().data() + sequence.getAmbiguousRuns().size()),
+		pos(0), 
+		word(0) {}
+
+	char next() {
+		if ((pos & 31) == 0) {
+			word = words[pos >> 5];
+		}
+		char symb = word & 3;
+		word >>= 2;
+
+		// inside a run of non-ACGT symbols
+		if (run != runsEnd && pos >= run->first) {
+			symb = -1;
+			if (pos + 1 == (size_t)run->first + run->second) {
+				++run;
+			}
+		}
+
+		++pos;
+		return symb;
+	}
+};
+
+
 // kmer filters
 class AlwaysPassFilter {
 public:
-	bool operator()(kmer_t kmer) { return true;  }
+	bool operator()(kmer_t kmer) const { return true;  }
 };
 
 class SetBasedFilter {
 	std::unordered_set<kmer_t> kmers;
 public:
 	SetBasedFilter(const std::unordered_set<kmer_t>& kmers) : kmers(kmers) {}
+	SetBasedFilter(std::unordered_set<kmer_t>&& kmers) : kmers(std::move(kmers)) {}
 
-	bool operator()(kmer_t kmer) { return kmers.find(kmer) != kmers.end(); }
+	// lookups do not modify the set - a filter may be shared by threads
+	bool operator()(kmer_t kmer) const { return kmers.find(kmer) != kmers.end(); }
 };
 
 
-// main extracting function
-template<KmerMode mode, class Filter>
-size_t extract_kmers(
-	char* sequence,
+// main extracting function (symbols are taken from the reader)
+template<KmerMode mode, class Filter, class SymbolReader>
+size_t extract_kmers_generic(
+	SymbolReader& reader,
 	size_t sequenceLength,
 	uint32_t kmerLength,
 	Filter& filter,
 	kmer_t* kmers,
 	uint32_t* positions) {
 
-	static char* map = []() {
-		static char _map[256];
-		std::fill_n(_map, 256, -1);
-		_map['a'] = _map['A'] = 0;
-		_map['c'] = _map['C'] = 1;
-		_map['g'] = _map['G'] = 2;
-		_map['t'] = _map['T'] = 3;
-		return _map;
-	}();
+	// no k-mers - symbols past the end of the sequence must not be read
+	if (sequenceLength < kmerLength) {
+		return 0;
+	}
 
 	size_t counter = 0;
 
@@ -86,7 +148,7 @@ size_t extract_kmers(
 
 	for (i = 0; i < kmerLength - 1; ++i, str_pos -= 2, rev_pos += 2)
 	{
-		char symb = map[static_cast<unsigned char>(sequence[i])];
+		char symb = reader.next();
 		if (symb < 0)
 		{
 			symb = 0;
@@ -98,7 +160,7 @@ size_t extract_kmers(
 
 	for (; i < sequenceLength; ++i)
 	{
-		char symb = map[static_cast<unsigned char>(sequence[i])];
+		char symb = reader.next();
 		if (symb < 0)
 		{
 			symb = 0;
@@ -137,3 +199,108 @@ size_t extract_kmers(
 
 }
 
+// extraction from a text sequence
+template<KmerMode mode, class Filter>
+size_t extract_kmers(
+	char* sequence,
+	size_t sequenceLength,
+	uint32_t kmerLength,
+	Filter& filter,
+	kmer_t* kmers,
+	uint32_t* positions) {
+
+	CharSymbolReader reader(sequence);
+	return extract_kmers_generic<mode, Filter, CharSymbolReader>(reader, sequenceLength, kmerLength, filter, kmers, positions);
+}
+
+// extraction from a 2-bit packed sequence (no re-encoding of symbols)
+template<KmerMode mode, class Filter>
+size_t extract_kmers(
+	const PackedSequence& sequence,
+	uint32_t kmerLength,
+	Filter& filter,
+	kmer_t* kmers,
+	uint32_t* positions) {
+
+	PackedSymbolReader reader(sequence);
+	return extract_kmers_generic<mode, Filter, PackedSymbolReader>(reader, sequence.size(), kmerLength, filter, kmers, positions);
+}
+
+// extraction of k-mers of several lengths (at most 32) in a single scan - k-mers are the same
+// as extracted separately for every length; k-mers of length kmerLengths[j] are appended to kmers[j]
+template<KmerMode mode, class SymbolReader>
+void extract_kmers_multi_generic(
+	SymbolReader& reader,
+	size_t sequenceLength,
+	const std::vector<uint32_t>& kmerLengths,
+	std::vector<kmer_t>* kmers) {
+
+	// k-mers of all lengths are taken from the k-mers of the maximum length
+	uint32_t maxLength = *std::max_element(kmerLengths.begin(), kmerLengths.end());
+	uint32_t max_len_shift = (maxLength - 1) * 2;
+	kmer_t max_mask = (maxLength == 32) ? ~0ull : (1ull << (2 * maxLength)) - 1;
+
+	size_t n = kmerLengths.size();
+	std::vector<kmer_t> str_masks(n), tail_masks(n);
+	std::vector<uint32_t> rev_shifts(n), prefix_shifts(n);
+
+	for (size_t j = 0; j < n; ++j) {
+		uint32_t k = kmerLengths[j];
+		str_masks[j] = (k == 32) ? ~0ull : (1ull << (2 * k)) - 1;
+		rev_shifts[j] = (maxLength - k) * 2;
+
+		// ensure at least 8-bit prefix (as in extract_kmers_generic)
+		int prefix_bits = ((int)k - SUFFIX_LEN) * 2;
+		prefix_shifts[j] = prefix_bits < 8 ? (uint32_t)(8 - prefix_bits) : 0;
+		tail_masks[j] = (1ull << prefix_shifts[j]) - 1;
+	}
+
+	kmer_t kmer_str = 0, kmer_rev = 0;
+	uint32_t valid = 0;	// number of ACGT symbols ending at the current position
+
+	for (size_t i = 0; i < sequenceLength; ++i) {
+		char symb = reader.next();
+		if (symb < 0) {
+			symb = 0;
+			valid = 0;
+		}
+		else {
+			++valid;
+		}
+
+		kmer_str = ((kmer_str << 2) + (kmer_t)symb) & max_mask;
+		kmer_rev = (kmer_rev >> 2) + ((kmer_t)(3 - symb) << max_len_shift);
+
+		for (size_t j = 0; j < n; ++j) {
+			if (valid < kmerLengths[j]) {
+				continue;
+			}
+
+			kmer_t kmer_can = select_kmer<mode>(kmer_str & str_masks[j], kmer_rev >> rev_shifts[j]);
+			kmers[j].push_back((kmer_can << prefix_shifts[j]) | (kmer_can & tail_masks[j]));
+		}
+	}
+}
+
+// extraction of several lengths from a text sequence
+template<KmerMode mode>
+void extract_kmers_multi(
+	char* sequence,
+	size_t sequenceLength,
+	const std::vector<uint32_t>& kmerLengths,
+	std::vector<kmer_t>* kmers) {
+
+	CharSymbolReader reader(sequence);
+	extract_kmers_multi_generic<mode, CharSymbolReader>(reader, sequenceLength, kmerLengths, kmers);
+}
+
+// extraction of several lengths from a 2-bit packed sequence
+template<KmerMode mode>
+void extract_kmers_multi(
+	const PackedSequence& sequence,
+	const std::vector<uint32_t>& kmerLengths,
+	std::vector<kmer_t>* kmers) {
+
+	PackedSymbolReader reader(sequence);
+	extract_kmers_multi_generic<mode, PackedSymbolReader>(reader, sequence.size(), kmerLengths, kmers);
+}
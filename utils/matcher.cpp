@@ -17,6 +17,12 @@ program. If not, see https://www.gnu.org/licenses/.
 
 ******************************************************************************/
 #include "input_file.h"
+#include "fasta_loader.h"
+#include "params.h"
+#include "dust.h"
+#include "numa.h"
+#include "suffix_array.h"
+#include "spacer_search.h"
 
 #include <algorithm>
 #include <fstream>
@@ -25,10 +31,21 @@ program. If not, see https://www.gnu.org/licenses/.
 #include <map>
 #include <chrono>
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <limits>
 
 
 using namespace std;
 
+// host k-mers never take this value (k-mers are at most 60 bits long)
+const kmer_t INVALID_KMER = ~0ull;
+
+// limit of results buffered for hosts waiting for their turn in the output
+const size_t MAX_BUFFERED_OUTPUT = (size_t)1 << 28;
+
 union GenomeCoords {
 	struct {
 		uint32_t pos;
@@ -52,7 +69,7 @@ struct Match {
 		host_last(host_last) 
 	{}
 
-	void asRanges(std::pair<uint32_t, uint32_t>& vir_range, std::pair<uint32_t, uint32_t>& host_range, int k) {
+	void asRanges(std::pair<uint32_t, uint32_t>& vir_range, std::pair<uint32_t, uint32_t>& host_range, int k) const {
 		
 		vir_range.first = vir_start + 1;
 		vir_range.second= vir_last + k ; // 1-based indexing
@@ -69,144 +86,381 @@ struct Match {
 };
 
 
-bool findSwitch(std::vector<std::string>& params, const std::string& name) {
-	auto it = find(params.begin(), params.end(), name); // verbose mode
-	if (it != params.end()) {
-		params.erase(it);
-		return true;
+// host indexing options
+struct IndexingParams {
+	int k;
+	uint32_t maxOccurrences;	// k-mers occurring more times are not indexed (0 - no limit)
+	int dustThreshold;			// low-complexity masking threshold (0 - no masking)
+	bool suffixArray;			// match with a suffix array of the host instead of its k-mer index
+};
+
+// numbers of host k-mers suppressed during indexing
+struct IndexingStats {
+	size_t maskedBases;
+	size_t maskedKmers;
+	size_t cappedKmers;
+	size_t cappedOccurrences;
+
+	IndexingStats() : maskedBases(0), maskedKmers(0), cappedKmers(0), cappedOccurrences(0) {}
+
+	void add(const IndexingStats& s) {
+		maskedBases += s.maskedBases;
+		maskedKmers += s.maskedKmers;
+		cappedKmers += s.cappedKmers;
+		cappedOccurrences += s.cappedOccurrences;
 	}
+};
 
-	return false;
-}
+// *****************************************************************************************
+// Writes results of hosts processed concurrently in the order of host identifiers (starting 
+// from 0). Results of a host which cannot be written yet are buffered, but the buffers are 
+// bounded: a host with more results, or one finished when the buffers are full, waits until
+// all preceding hosts are written and then streams its results directly.
+class OrderedOutput {
+public:
+	OrderedOutput(std::ostream& details, std::ostream* summary, size_t maxBuffered) :
+		details(details), summary(summary), maxBuffered(maxBuffered), bufferedBytes(0), nextToWrite(0) {}
+
+	// passes results of a host (the streams are emptied); with finished set, these are 
+	// the last results of the host
+	void put(size_t id, std::ostringstream& hostDetails, std::ostringstream& hostSummary, bool finished) {
+		std::unique_lock<std::mutex> lck(mtx);
+		size_t bytes = (size_t)hostDetails.tellp() + (size_t)hostSummary.tellp();
 
-template <typename T>
-bool findOption(std::vector<std::string>& params, const std::string& name, T& v) {
-	auto prevToEnd = std::prev(params.end());
-	auto it = find(params.begin(), prevToEnd, name); // verbose mode
-	if (it != prevToEnd) {
-		std::istringstream iss(*std::next(it));
-		if (iss >> v) {
-			params.erase(it, it + 2);
-			return true;
+		if (id != nextToWrite && (!finished || bufferedBytes + bytes > maxBuffered)) {
+			turn.wait(lck, [this, id]() { return nextToWrite == id; });
 		}
+
+		if (id != nextToWrite) {
+			buffered[id] = std::make_pair(hostDetails.str(), hostSummary.str());
+			bufferedBytes += bytes;
+		}
+		else {
+			details << hostDetails.str();
+			if (summary) {
+				*summary << hostSummary.str();
+			}
+			
+			if (finished) {
+				++nextToWrite;
+				for (auto it = buffered.begin(); it != buffered.end() && it->first == nextToWrite; ) {
+					details << it->second.first;
+					if (summary) {
+						*summary << it->second.second;
+					}
+					bufferedBytes -= it->second.first.size() + it->second.second.size();
+					it = buffered.erase(it);
+					++nextToWrite;
+				}
+				lck.unlock();
+				turn.notify_all();
+			}
+		}
+
+		hostDetails.str("");
+		hostSummary.str("");
 	}
 
-	return false;
-}
+protected:
+	std::ostream& details;
+	std::ostream* summary;
+	size_t maxBuffered;
+	size_t bufferedBytes;
+	size_t nextToWrite;
+	std::map<size_t, std::pair<std::string, std::string>> buffered;
 
-int main(int argc, char** argv) {
+	std::mutex mtx;
+	std::condition_variable turn;
+};
 
-	cout << "PHIST-Matcher utility 1.0.0" << endl
-		<< "A.Zielezinski, S. Deorowicz, A. Gudys (c) 2021" << endl << endl;
-	
-	std::vector<std::string> params(argc - 1);
-	std::transform(argv + 1, argv + argc, params.begin(), [](char* s)->string { return s; });
+// *****************************************************************************************
+// Receives matches found for consecutive virus records of a host. Matches are written in detail
+// (up to the given number per virus record) and aggregated into a summary row per virus record.
+// Results are passed to the ordered output in chunks of bounded size.
+class MatchCollector {
+public:
+	static const size_t CHUNK_SIZE = (size_t)1 << 24;
 
-	int k;
-	if (!findOption(params, "-k", k)) {
-		k = 25;
+	MatchCollector(
+		const std::string& hostName,
+		const FastaFile& hostFasta,
+		int k,
+		size_t maxDetails,
+		OrderedOutput& output,
+		size_t hostId,
+		bool withSummary) :
+		hostName(hostName), 
+		hostFasta(hostFasta), 
+		k(k), 
+		maxDetails(maxDetails), 
+		output(output),
+		hostId(hostId),
+		withSummary(withSummary) {}
+
+	void writeHeader(const std::string& virPath) {
+		details << virPath << "," << hostName << '\n';
 	}
 
-	if (params.size() != 3) {
-		cout << "USAGE:" << endl
-			<< "matcher [-k <length>] <phage> <host> <matches>" << endl << endl
-			<< "Parameters:" << endl
-			<< "\tlength - minimum match length (25 by default)" << endl
-			<< "\tphage - phage FASTA file (gzipped or not)" << endl
-			<< "\thost - host FASTA file (gzipped or not)" << endl
-			<< "\tmatches - CSV table with all exact matches" << endl;
-		return 0;
+	// passes remaining results to the output
+	void finish() {
+		output.put(hostId, details, summary, true);
 	}
 
-	auto start = std::chrono::high_resolution_clock::now();
+	void startRecord(const char* header, size_t length) {
+		virHeader = header;
+		numDetails = 0;
+		numForward = numReverse = 0;
+		longest = 0;
+		if (withSummary) {
+			coverageDelta.assign(length + 1, 0);
+			hostRegions.clear();
+			compactAt = MIN_COMPACT_SIZE;
+		}
+	}
 
-	const std::string& virPath = params[0];
-	const std::string& hostPath = params[1];
+	void add(const Match& m) {
+		std::pair<uint32_t, uint32_t> vir_range, host_range;
+		m.asRanges(vir_range, host_range, k);
 
-	cout << "Finding exact matches..." << endl
-		<< "minimum length: " << k << endl
-		<< "phage FASTA:    " << virPath << endl
-		<< "host FASTA:     " << hostPath << endl  << endl;
+		if (numDetails < maxDetails) {
+			details
+				<< virHeader << ':' << vir_range.first << "-" << vir_range.second << ","
+				<< hostFasta.getHeaders()[m.host_last.chr] << ":" << host_range.first << "-" << host_range.second << '\n';
+			++numDetails;
 
-	FastaFile virFasta;
-	FastaFile hostFasta;
-	if (!virFasta.open(virPath) || !hostFasta.open(hostPath)) {
-		cout << "Unable to open input files" << endl;
-		return -1;
+			if ((size_t)details.tellp() > CHUNK_SIZE) {
+				output.put(hostId, details, summary, false);
+			}
+		}
+
+		if (withSummary) {
+			if (m.host_last.is_rev) {
+				++numReverse;
+			}
+			else {
+				++numForward;
+			}
+
+			longest = std::max(longest, vir_range.second - vir_range.first + 1);
+			
+			// on repetitive hosts a match may be extended past the record end
+			size_t last = std::min<size_t>(vir_range.second, coverageDelta.size() - 1);
+			++coverageDelta[vir_range.first - 1];
+			--coverageDelta[last];
+
+			// host intervals are merged regardless of the strand
+			uint64_t chr = m.host_last.chr;
+			uint32_t hostFirst = std::min(host_range.first, host_range.second);
+			uint32_t hostLast = std::min<uint32_t>(std::max(host_range.first, host_range.second), (uint32_t)hostFasta.getLengths()[chr]);
+			hostRegions.emplace_back((chr << 32) | hostFirst, hostLast);
+			
+			// repetitive pairs produce many overlapping intervals - keep only merged ones
+			if (hostRegions.size() >= compactAt) {
+				mergeHostRegions();
+				compactAt = MIN_COMPACT_SIZE + 2 * hostRegions.size();
+			}
+		}
 	}
 
-	std::vector<std::vector<kmer_t>> virKmerCollections(virFasta.numSubsequences());
-	std::unordered_set<kmer_t> uniqueKmers; // this set will be used for filtering host kmers
-	AlwaysPassFilter apf;
+	void finishRecord() {
+		if (!withSummary || numForward + numReverse == 0) {
+			return;
+		}
 
-	// iterate over virus subsequences
-	for (int chr_id = 0; chr_id < virKmerCollections.size(); ++chr_id) {
-		std::vector<kmer_t>& kmers = virKmerCollections[chr_id];
-		
-		kmers.resize(virFasta.getLengths()[chr_id] - k + 1);
-		
-		extract_kmers<KmerMode::Forward, AlwaysPassFilter>(
-			virFasta.getSubsequences()[chr_id], 
-			virFasta.getLengths()[chr_id], 
-			k, 
-			apf, 
-			kmers.data(), 
-			nullptr);
+		// phage bases covered by at least one match
+		size_t covered = 0;
+		int32_t depth = 0;
+		for (int32_t d : coverageDelta) {
+			depth += d;
+			covered += depth > 0;
+		}
 
-		for (auto kmer : kmers) {
-			uniqueKmers.insert(kmer);
+		// host regions hit and bases covered by them
+		mergeHostRegions();
+		size_t hostCovered = 0;
+		for (const auto& r : hostRegions) {
+			hostCovered += r.second - (uint32_t)r.first + 1;
 		}
+
+		summary << virHeader << ',' << hostName << ',' << numForward << ',' << numReverse << ','
+			<< covered << ',' << longest << ',' << hostRegions.size() << ',' << hostCovered << '\n';
 	}
 
-	// iterate over host subsequences
-	std::multimap<kmer_t, GenomeCoords> hostKmers;
+protected:
+	const std::string& hostName;
+	const FastaFile& hostFasta;
+	int k;
+	size_t maxDetails;
+	OrderedOutput& output;
+	size_t hostId;
+	bool withSummary;
+
+	std::ostringstream details;
+	std::ostringstream summary;
+	std::string virHeader;
+	size_t numDetails;
+	size_t numForward;
+	size_t numReverse;
+	uint32_t longest;
+	std::vector<int32_t> coverageDelta;
 
+	// 1-based host intervals: (record << 32 | first, last)
+	static const size_t MIN_COMPACT_SIZE = 1024;
+	std::vector<std::pair<uint64_t, uint32_t>> hostRegions;
+	size_t compactAt;
 
-	SetBasedFilter filter(uniqueKmers);
+	// sorts host intervals and merges overlapping or adjacent ones
+	void mergeHostRegions() {
+		std::sort(hostRegions.begin(), hostRegions.end());
+		
+		size_t out = 0;
+		for (size_t i = 0; i < hostRegions.size(); ++i) {
+			const auto& r = hostRegions[i];
+			if (out > 0 && (hostRegions[out - 1].first >> 32) == (r.first >> 32) 
+				&& (uint32_t)r.first <= (uint64_t)hostRegions[out - 1].second + 1) {
+				hostRegions[out - 1].second = std::max(hostRegions[out - 1].second, r.second);
+			}
+			else {
+				hostRegions[out++] = r;
+			}
+		}
+		hostRegions.resize(out);
+	}
+};
 
+// *****************************************************************************************
+// Extracts host k-mers from a text or 2-bit packed subsequence.
+template <KmerMode mode>
+size_t extractHostKmers(
+	const FastaFile& hostFasta,
+	size_t chr_id,
+	int k,
+	const SetBasedFilter& filter,
+	kmer_t* kmers,
+	uint32_t* positions) {
+
+	if (hostFasta.isPacked()) {
+		return extract_kmers<mode, const SetBasedFilter>(
+			hostFasta.getPackedSubsequences()[chr_id],
+			k,
+			filter,
+			kmers,
+			positions);
+	}
+	
+	return extract_kmers<mode, const SetBasedFilter>(
+		hostFasta.getSubsequences()[chr_id],
+		hostFasta.getLengths()[chr_id],
+		k,
+		filter,
+		kmers,
+		positions);
+}
+
+// *****************************************************************************************
+// Finds low-complexity regions in a text or 2-bit packed subsequence.
+void findHostLowComplexity(
+	const FastaFile& hostFasta,
+	size_t chr_id,
+	int threshold,
+	std::vector<PackedSequence::Run>& regions) {
+
+	if (hostFasta.isPacked()) {
+		PackedSymbolReader reader(hostFasta.getPackedSubsequences()[chr_id]);
+		find_low_complexity_regions(reader, hostFasta.getLengths()[chr_id], threshold, regions);
+	}
+	else {
+		CharSymbolReader reader(hostFasta.getSubsequences()[chr_id]);
+		find_low_complexity_regions(reader, hostFasta.getLengths()[chr_id], threshold, regions);
+	}
+}
+
+// *****************************************************************************************
+// Indexes host k-mers (both strands) present in the filter.
+void buildHostIndex(
+	const FastaFile& hostFasta,
+	const IndexingParams& ip,
+	const SetBasedFilter& filter,
+	std::multimap<kmer_t, GenomeCoords>& hostKmers,
+	IndexingStats& stats) {
+
+	int k = ip.k;
+	std::vector<PackedSequence::Run> masked;
+
+	// iterate over host subsequences
 	for (uint16_t chr_id = 0; chr_id < hostFasta.numSubsequences(); ++chr_id) {
+		if (hostFasta.getLengths()[chr_id] < (size_t)k) {
+			continue;
+		}
+
+		if (ip.dustThreshold > 0) {
+			findHostLowComplexity(hostFasta, chr_id, ip.dustThreshold, masked);
+			for (const auto& r : masked) {
+				stats.maskedBases += r.second;
+			}
+		}
+
 		std::vector<kmer_t> kmers(hostFasta.getLengths()[chr_id] - k + 1);
 		std::vector<uint32_t> positions(hostFasta.getLengths()[chr_id] - k + 1);
 
 		// forward direction
-		size_t count = extract_kmers<KmerMode::Forward, SetBasedFilter>(
-			hostFasta.getSubsequences()[chr_id],
-			hostFasta.getLengths()[chr_id],
-			k,
-			filter,
-			kmers.data(),
-			positions.data());
+		size_t count = extractHostKmers<KmerMode::Forward>(hostFasta, chr_id, k, filter, kmers.data(), positions.data());
+		if (masked.size()) {
+			size_t unmasked = remove_masked_kmers(masked, k, kmers.data(), positions.data(), count);
+			stats.maskedKmers += count - unmasked;
+			count = unmasked;
+		}
 
-		for (int i = 0; i < count; ++i) {
+		for (size_t i = 0; i < count; ++i) {
 			GenomeCoords coords = { positions[i], chr_id, 0 };
 			hostKmers.insert(std::make_pair(kmers[i], coords));
 		}
 
 		// reverse direction
-		count = extract_kmers<KmerMode::Reverse, SetBasedFilter>(
-			hostFasta.getSubsequences()[chr_id],
-			hostFasta.getLengths()[chr_id],
-			k,
-			filter,
-			kmers.data(),
-			positions.data());
+		count = extractHostKmers<KmerMode::Reverse>(hostFasta, chr_id, k, filter, kmers.data(), positions.data());
+		if (masked.size()) {
+			size_t unmasked = remove_masked_kmers(masked, k, kmers.data(), positions.data(), count);
+			stats.maskedKmers += count - unmasked;
+			count = unmasked;
+		}
 
-		for (int i = 0; i < count; ++i) {
+		for (size_t i = 0; i < count; ++i) {
 			GenomeCoords coords = { positions[i], chr_id, 1 };
 			hostKmers.insert(std::make_pair(kmers[i], coords));
 		}
 	}
 
-	// perform matching from virus point of view
-	ofstream outfile(params[2]);
-	outfile << virPath << "," << hostPath << endl;
+	// remove highly repetitive k-mers
+	if (ip.maxOccurrences > 0) {
+		for (auto it = hostKmers.begin(); it != hostKmers.end(); ) {
+			auto next = hostKmers.upper_bound(it->first);
+			size_t n = std::distance(it, next);
+
+			if (n > ip.maxOccurrences) {
+				++stats.cappedKmers;
+				stats.cappedOccurrences += n;
+				it = hostKmers.erase(it, next);
+			}
+			else {
+				it = next;
+			}
+		}
+	}
+}
+
+void findMatches(
+	const FastaFile& virFasta, 
+	const std::vector<std::vector<kmer_t>>& virKmerCollections,
+	const std::multimap<kmer_t, GenomeCoords>& hostKmers,
+	MatchCollector& collector) {
 
+	// perform matching from virus point of view
 	std::vector<Match> matches;
 
 	// iterate over virus chromosomes
-	for (int vir_cid = 0; vir_cid < virKmerCollections.size(); ++vir_cid) {
+	for (size_t vir_cid = 0; vir_cid < virKmerCollections.size(); ++vir_cid) {
 		const auto& col = virKmerCollections[vir_cid];
-		string vir_header = virFasta.getHeaders()[vir_cid];
+		collector.startRecord(virFasta.getHeaders()[vir_cid], virFasta.getLengths()[vir_cid]);
 		
 		// iterate over virus positions
 		for (uint64_t vir_pos = 0; vir_pos < col.size(); ++vir_pos) {
@@ -251,14 +505,7 @@ int main(int argc, char** argv) {
 			for (auto it = matches.begin(); it != matches.end(); )
 			{
 				if (it->vir_last != vir_pos) {
-					
-					std::pair<uint32_t, uint32_t> vir_range, host_range;
-					it->asRanges(vir_range, host_range, k);
-					
-					outfile
-						<< vir_header << ':' << vir_range.first << "-" << vir_range.second << ","  
-						<< hostFasta.getHeaders()[it->host_last.chr] << ":" << host_range.first << "-" << host_range.second << endl;
-
+					collector.add(*it);
 					it = matches.erase(it);
 				}
 				else {
@@ -269,22 +516,912 @@ int main(int argc, char** argv) {
 
 		// if there are some matches left
 		for (auto it = matches.begin(); it != matches.end(); ++it) {
-			std::pair<uint32_t, uint32_t> vir_range, host_range;
-			it->asRanges(vir_range, host_range, k);
-
-			outfile
-				<< vir_header << ':' << vir_range.first << "-" << vir_range.second << ","
-				<< hostFasta.getHeaders()[it->host_last.chr] << ":" << host_range.first << "-" << host_range.second << endl;
+			collector.add(*it);
 		}
 		matches.clear();
+		collector.finishRecord();
 	} 
+}
+
+// *****************************************************************************************
+// Suffix array engine. The suffix array is built over both strands of a host by the worker 
+// processing it, phages of the batch are streamed against it. The host text consists of 
+// the forward and the reverse complement strand of every record with nucleotides coded 1-4, 
+// each terminated with a separator which also replaces non-ACGT and masked symbols, and ends
+// with a unique 0. Non-ACGT phage symbols are coded with a value matching nothing.
+const uint8_t SA_SEPARATOR = 5;
+const uint8_t SA_PHAGE_INVALID = 6;
+
+// suffix indices are 32-bit signed integers
+const size_t SA_MAX_TEXT = ((size_t)1 << 31) - 1;
+
+struct HostSuffixIndex {
+	SuffixArray sa;
+	std::vector<uint32_t> starts;	// text offsets of strands (2 * record + is_rev)
+};
+
+// *****************************************************************************************
+// Codes a host record on the given strand.
+template <class SymbolReader>
+void encodeHostStrand(
+	SymbolReader& reader,
+	size_t length,
+	const std::vector<PackedSequence::Run>& masked,
+	bool reverse,
+	std::vector<uint8_t>& strand) {
+
+	strand.resize(length);
+	for (size_t i = 0; i < length; ++i) {
+		char symb = reader.next();
+		strand[i] = symb < 0 ? SA_SEPARATOR : (uint8_t)(symb + 1);
+	}
+
+	for (const auto& r : masked) {
+		std::fill_n(strand.begin() + r.first, r.second, SA_SEPARATOR);
+	}
+
+	// complement maps 1-4 onto 4-1
+	if (reverse) {
+		std::reverse(strand.begin(), strand.end());
+		for (auto& c : strand) {
+			if (c != SA_SEPARATOR) {
+				c = 5 - c;
+			}
+		}
+	}
+}
+
+// *****************************************************************************************
+// Builds the suffix array of both strands of a host; returns false if the host is too long.
+bool buildHostSuffixIndex(
+	const FastaFile& hostFasta,
+	const IndexingParams& ip,
+	HostSuffixIndex& index,
+	IndexingStats& stats) {
+
+	size_t numRecords = hostFasta.numSubsequences();
+	size_t total = 1;
+	for (size_t chr_id = 0; chr_id < numRecords; ++chr_id) {
+		total += 2 * (hostFasta.getLengths()[chr_id] + 1);
+	}
+	if (total > SA_MAX_TEXT) {
+		return false;
+	}
+
+	std::vector<uint8_t> text;
+	text.reserve(total);
+	index.starts.clear();
+
+	std::vector<PackedSequence::Run> masked;
+	std::vector<uint8_t> strand;
+
+	for (size_t chr_id = 0; chr_id < numRecords; ++chr_id) {
+		size_t len = hostFasta.getLengths()[chr_id];
+
+		masked.clear();
+		if (ip.dustThreshold > 0) {
+			findHostLowComplexity(hostFasta, chr_id, ip.dustThreshold, masked);
+			for (const auto& r : masked) {
+				stats.maskedBases += r.second;
+			}
+		}
+
+		for (int reverse = 0; reverse < 2; ++reverse) {
+			if (hostFasta.isPacked()) {
+				PackedSymbolReader reader(hostFasta.getPackedSubsequences()[chr_id]);
+				encodeHostStrand(reader, len, masked, reverse != 0, strand);
+			}
+			else {
+				CharSymbolReader reader(hostFasta.getSubsequences()[chr_id]);
+				encodeHostStrand(reader, len, masked, reverse != 0, strand);
+			}
+
+			index.starts.push_back((uint32_t)text.size());
+			text.insert(text.end(), strand.begin(), strand.end());
+			text.push_back(SA_SEPARATOR);
+		}
+	}
+
+	text.push_back(0);
+	index.sa.build(std::move(text), SA_SEPARATOR, ip.k);
+	return true;
+}
+
+// *****************************************************************************************
+// Locates the k-mer starting at every position of a phage record in the host suffix array. 
+// The record is scanned from its end by backward search; when the pattern cannot be extended,
+// the interval is widened to its parent (matching statistics), and patterns longer than k are
+// shortened the same way. Calls f(pos, lo, hi) for positions of k-mers present in the host.
+template <class Callback>
+void scanPhage(
+	const SuffixArray& sa, 
+	const std::vector<uint8_t>& phage, 
+	uint32_t k, 
+	Callback f) {
+
+	uint32_t lo = 0, hi = (uint32_t)sa.size();
+	uint32_t depth = 0;
+
+	for (size_t pos = phage.size(); pos-- > 0; ) {
+		uint8_t c = phage[pos];
+		if (c == SA_PHAGE_INVALID) {
+			lo = 0;
+			hi = (uint32_t)sa.size();
+			depth = 0;
+			continue;
+		}
+
+		for (;;) {
+			if (sa.extend(c, lo, hi)) {
+				++depth;
+				break;
+			}
+			// the nucleotide is absent from the host
+			if (depth == 0) {
+				break;
+			}
+			depth = sa.parent(lo, hi);
+		}
+
+		if (depth > k) {
+			if (sa.boundaryLcp(lo, hi) == k) {
+				sa.parent(lo, hi);
+			}
+			depth = k;
+		}
+
+		if (depth == k) {
+			f((uint32_t)pos, lo, hi);
+		}
+	}
+}
+
+// *****************************************************************************************
+// Finds maximal exact matches of at least k symbols between the phage batch and both strands 
+// of the host. A match is reported at its leftmost phage position only, from the host suffixes
+// of the k-mer interval not preceded by the previous phage symbol, and then extended to the 
+// right. K-mers occurring in the host more often than the cap neither start nor continue 
+// matches, so the result is the same as with the k-mer index. Matches are collected for one
+// phage record at a time.
+void findMatchesSA(
+	const FastaFile& virFasta,
+	const FastaFile& hostFasta,
+	const HostSuffixIndex& index,
+	const IndexingParams& ip,
+	MatchCollector& collector,
+	IndexingStats& stats) {
+
+	uint32_t k = (uint32_t)ip.k;
+	const SuffixArray& sa = index.sa;
+	const std::vector<uint8_t>& text = sa.getText();
+
+	// occurrences of a k-mer in the host are given by the size of its interval 
+	std::unordered_set<uint32_t> cappedKmers;
+	auto isCapped = [&](uint32_t lo, uint32_t hi) {
+		if (ip.maxOccurrences == 0 || hi - lo <= ip.maxOccurrences) {
+			return false;
+		}
+		if (cappedKmers.insert(lo).second) {
+			++stats.cappedKmers;
+			stats.cappedOccurrences += hi - lo;
+		}
+		return true;
+	};
+
+	std::vector<uint8_t> phage;
+	std::vector<bool> capped;
+	std::vector<Match> matches;
+	std::vector<uint32_t> starts;
+
+	for (size_t vir_cid = 0; vir_cid < virFasta.numSubsequences(); ++vir_cid) {
+		uint32_t virLen = (uint32_t)virFasta.getLengths()[vir_cid];
+		CharSymbolReader reader(virFasta.getSubsequences()[vir_cid]);
+		phage.resize(virLen);
+		for (auto& c : phage) {
+			char symb = reader.next();
+			c = symb < 0 ? SA_PHAGE_INVALID : (uint8_t)(symb + 1);
+		}
+
+		capped.assign(virLen, false);
+		matches.clear();
+
+		// matches starting at a position are reported once the previous position is known
+		auto report = [&](uint32_t pos, uint32_t lo, uint32_t hi, bool prevCapped) {
+			if (capped[pos]) {
+				return;
+			}
+
+			uint8_t prev = (pos == 0 || prevCapped) ? SA_PHAGE_INVALID : phage[pos - 1];
+			starts.clear();
+			sa.notPreceded(lo, hi, prev, starts);
+
+			for (uint32_t j : starts) {
+				// the host text ends with 0 which stops the extension
+				uint32_t len = k;
+				while (pos + len < virLen && phage[pos + len] == text[j + len]) {
+					++len;
+				}
+
+				for (uint32_t next = pos + 1; next + k <= pos + len; ++next) {
+					if (capped[next]) {
+						len = next - 1 - pos + k;
+						break;
+					}
+				}
+
+				size_t strand_id = std::upper_bound(index.starts.begin(), index.starts.end(), j) - index.starts.begin() - 1;
+				uint32_t off = j - index.starts[strand_id];
+				size_t chr_id = strand_id / 2;
+				uint32_t hostLen = (uint32_t)hostFasta.getLengths()[chr_id];
+
+				GenomeCoords host_start, host_last;
+				host_start.chr = (uint16_t)chr_id;
+				host_start.is_rev = (uint16_t)(strand_id % 2);
+
+				if (!host_start.is_rev) {
+					host_start.pos = off;
+					host_last = host_start;
+					host_last.pos += len - k;
+				}
+				else {
+					// positions of k-mers on the forward strand
+					host_start.pos = hostLen - off - k;
+					host_last = host_start;
+					host_last.pos = hostLen - off - len;
+				}
+
+				matches.emplace_back(pos, pos + len - k, host_start, host_last);
+			}
+		};
+
+		bool pending = false;
+		uint32_t pendingPos = 0, pendingLo = 0, pendingHi = 0;
+
+		scanPhage(sa, phage, k, [&](uint32_t pos, uint32_t lo, uint32_t hi) {
+			capped[pos] = isCapped(lo, hi);
+			if (pending) {
+				report(pendingPos, pendingLo, pendingHi, pendingPos == pos + 1 && capped[pos]);
+			}
+			pending = true;
+			pendingPos = pos;
+			pendingLo = lo;
+			pendingHi = hi;
+		});
+
+		if (pending) {
+			report(pendingPos, pendingLo, pendingHi, false);
+		}
+
+		// order of the k-mer index engine
+		std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+			if (a.vir_last != b.vir_last) { return a.vir_last < b.vir_last; }
+			if (a.vir_start != b.vir_start) { return a.vir_start < b.vir_start; }
+			if (a.host_start.chr != b.host_start.chr) { return a.host_start.chr < b.host_start.chr; }
+			if (a.host_start.is_rev != b.host_start.is_rev) { return a.host_start.is_rev < b.host_start.is_rev; }
+			return a.host_start.pos < b.host_start.pos;
+		});
+
+		collector.startRecord(virFasta.getHeaders()[vir_cid], virFasta.getLengths()[vir_cid]);
+		for (const auto& m : matches) {
+			collector.add(m);
+		}
+		collector.finishRecord();
+	}
+}
+
+// *****************************************************************************************
+// Extracts k-mers at all positions of virus subsequences. Positions with no valid k-mer
+// (containing non-ACGT symbols) get a value never present in the host.
+void extractVirusKmers(
+	const FastaFile& virFasta,
+	int k,
+	std::vector<std::vector<kmer_t>>& virKmerCollections,
+	std::unordered_set<kmer_t>& uniqueKmers) {
+
+	virKmerCollections.assign(virFasta.numSubsequences(), std::vector<kmer_t>());
+	uniqueKmers.clear();
+	AlwaysPassFilter apf;
+	std::vector<kmer_t> valid;
+	std::vector<uint32_t> positions;
+
+	// iterate over virus subsequences
+	for (size_t chr_id = 0; chr_id < virKmerCollections.size(); ++chr_id) {
+		size_t len = virFasta.getLengths()[chr_id];
+		if (len < (size_t)k) {
+			continue;
+		}
+
+		std::vector<kmer_t>& kmers = virKmerCollections[chr_id];
+		kmers.assign(len - k + 1, INVALID_KMER);
+		valid.resize(len - k + 1);
+		positions.resize(len - k + 1);
+		
+		size_t count = extract_kmers<KmerMode::Forward, AlwaysPassFilter>(
+			virFasta.getSubsequences()[chr_id], 
+			len,
+			k, 
+			apf, 
+			valid.data(), 
+			positions.data());
+
+		for (size_t i = 0; i < count; ++i) {
+			kmers[positions[i]] = valid[i];
+			uniqueKmers.insert(valid[i]);
+		}
+	}
+}
+
+// *****************************************************************************************
+// Hosts kept loaded while all virus batches are matched against them.
+struct HostGroup {
+	std::vector<size_t> ids;	// identifiers in the loader
+	std::vector<std::unique_ptr<FastaFile>> files;
+};
+
+// *****************************************************************************************
+// Matches a batch of virus sequences against the hosts of a group or, with no group, against
+// all hosts taken from the loader. Results are written in the order of hosts.
+bool matchHosts(
+	const std::string& virPath,
+	const FastaFile& virFasta,
+	FastaLoader& hostLoader,
+	const HostGroup* group,
+	const IndexingParams& ip,
+	int numThreads,
+	const NumaTopology* numa,
+	size_t maxDetails,
+	IndexingStats& stats,
+	std::ostream& outfile,
+	std::ostream* summaryFile) {
+
+	int k = ip.k;
+
+	std::vector<std::vector<kmer_t>> virKmerCollections;
+	std::unordered_set<kmer_t> uniqueKmers;
+	if (!ip.suffixArray) {
+		extractVirusKmers(virFasta, k, virKmerCollections, uniqueKmers);
+	}
+
+	// the filter of host k-mers is read-only and shared by all workers
+	SetBasedFilter filter(std::move(uniqueKmers));
+
+	// with NUMA binding, virus k-mers and the filter are replicated by threads bound to the 
+	// nodes, so that every copy is allocated locally (first touch); host indices (k-mer or 
+	// suffix array) are built by the bound workers themselves
+	std::vector<std::vector<std::vector<kmer_t>>> nodeCollections;
+	std::vector<std::unique_ptr<SetBasedFilter>> nodeFilters;
+	if (numa && numa->numNodes() > 1) {
+		nodeCollections.resize(numa->numNodes());
+		nodeFilters.resize(numa->numNodes());
+		std::vector<std::thread> replicators;
+		for (size_t node = 0; node < numa->numNodes(); ++node) {
+			replicators.emplace_back([&, node]() {
+				numa->bindCurrentThread(node);
+				nodeCollections[node] = virKmerCollections;
+				nodeFilters[node].reset(new SetBasedFilter(filter));
+			});
+		}
+		for (auto& r : replicators) {
+			r.join();
+		}
+	}
+
+	// detailed and summary results are written in the order of hosts
+	OrderedOutput output(outfile, summaryFile, MAX_BUFFERED_OUTPUT);
+	bool allOk = true;
+	std::mutex outMutex;
+
+	size_t numHosts = group ? group->files.size() : hostLoader.size();
+	std::atomic<size_t> nextInGroup(0);
+
+	numThreads = std::max(1, std::min(numThreads, (int)numHosts));
+	std::vector<std::thread> workers;
+	for (int tid = 0; tid < numThreads; ++tid) {
+		workers.emplace_back([&, tid]() {
+			const std::vector<std::vector<kmer_t>>* collections = &virKmerCollections;
+			const SetBasedFilter* nodeFilter = &filter;
+			if (numa) {
+				size_t node = numa->nodeForWorker(tid);
+				numa->bindCurrentThread(node);
+				if (nodeCollections.size()) {
+					collections = &nodeCollections[node];
+					nodeFilter = nodeFilters[node].get();
+				}
+			}
+
+			IndexingStats localStats;
+
+			for (;;) {
+				// position in the output, identifier in the loader
+				size_t slot, host_id;
+				std::unique_ptr<FastaFile> loaded;
+				const FastaFile* hostFasta;
+				bool ok = true;
+
+				if (group) {
+					if ((slot = nextInGroup++) >= numHosts) {
+						break;
+					}
+					host_id = group->ids[slot];
+					hostFasta = group->files[slot].get();
+				}
+				else {
+					if (!hostLoader.pop(host_id, loaded, ok)) {
+						break;
+					}
+					slot = host_id;
+					hostFasta = loaded.get();
+				}
+
+				// hosts too long for the suffix array engine are handled as failed ones
+				HostSuffixIndex hostIndex;
+				bool indexed = ok && (!ip.suffixArray || buildHostSuffixIndex(*hostFasta, ip, hostIndex, localStats));
+
+				if (!indexed) {
+					{
+						std::lock_guard<std::mutex> lck(outMutex);
+						cout << (ok ? "Host too long for the suffix array engine: " : "Unable to open host file: ") 
+							<< hostLoader.getPath(host_id) << endl;
+						allOk = false;
+					}
+
+					// failed hosts have no results, but still take their turn in the output
+					std::ostringstream none, noSummary;
+					output.put(slot, none, noSummary, true);
+					continue;
+				}
+				
+				const std::string& hostPath = hostLoader.getPath(host_id);
+				MatchCollector collector(hostPath, *hostFasta, k, maxDetails, output, slot, summaryFile != nullptr);
+				collector.writeHeader(virPath);
+					
+				if (ip.suffixArray) {
+					findMatchesSA(virFasta, *hostFasta, hostIndex, ip, collector, localStats);
+				}
+				else {
+					std::multimap<kmer_t, GenomeCoords> hostKmers;
+					buildHostIndex(*hostFasta, ip, *nodeFilter, hostKmers, localStats);
+					findMatches(virFasta, *collections, hostKmers, collector);
+				}
+				
+				collector.finish();
+			}
+
+			std::lock_guard<std::mutex> lck(outMutex);
+			stats.add(localStats);
+		});
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	if (numa) {
+		std::vector<size_t> usage = numa->processMemoryPerNode();
+		cout << "Memory usage per NUMA node:";
+		for (size_t node = 0; node < usage.size(); ++node) {
+			cout << " " << node << ": " << usage[node] / (1 << 20) << " MB";
+		}
+		cout << endl;
+	}
+
+	return allOk;
+}
+
+// *****************************************************************************************
+// Searches a batch of phage records for spacer occurrences with up to the given number of 
+// mismatches. Records are distributed among threads in chunks, results are written in order.
+bool matchSpacers(
+	const FastaFile& virFasta,
+	const FastaFile& spacerFasta,
+	const SpacerIndex& index,
+	int numThreads,
+	size_t maxDetails,
+	std::ostream& outfile) {
+
+	const size_t CHUNK_SIZE = 16;
+	size_t numChunks = (virFasta.numSubsequences() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	std::atomic<size_t> nextChunk(0);
+
+	std::map<size_t, std::string> pendingResults;
+	size_t nextToWrite = 0;
+	std::mutex outMutex;
+
+	numThreads = std::max(1, std::min(numThreads, (int)numChunks));
+	std::vector<std::thread> workers;
+	for (int tid = 0; tid < numThreads; ++tid) {
+		workers.emplace_back([&]() {
+			std::vector<SpacerHit> hits;
+			size_t chunk_id;
+
+			while ((chunk_id = nextChunk++) < numChunks) {
+				std::ostringstream oss;
+				size_t last = std::min((chunk_id + 1) * CHUNK_SIZE, virFasta.numSubsequences());
+
+				for (size_t vir_cid = chunk_id * CHUNK_SIZE; vir_cid < last; ++vir_cid) {
+					index.search(virFasta.getSubsequences()[vir_cid], virFasta.getLengths()[vir_cid], hits);
+					const char* virHeader = virFasta.getHeaders()[vir_cid];
+					
+					size_t n = std::min(hits.size(), maxDetails);
+					for (size_t i = 0; i < n; ++i) {
+						const SpacerHit& h = hits[i];
+						uint32_t len = index.getLength(h.spacer);
+						
+						// 1-based indexing, reverse complement matches with reversed spacer range
+						oss << virHeader << ':' << h.pos + 1 << '-' << h.pos + len << ','
+							<< spacerFasta.getHeaders()[h.spacer] << ':' 
+							<< (h.is_rev ? len : 1) << '-' << (h.is_rev ? 1 : len) << ','
+							<< h.mismatches << '\n';
+					}
+				}
+
+				std::lock_guard<std::mutex> lck(outMutex);
+				pendingResults[chunk_id] = oss.str();
+				for (auto it = pendingResults.begin(); it != pendingResults.end() && it->first == nextToWrite; ) {
+					outfile << it->second;
+					it = pendingResults.erase(it);
+					++nextToWrite;
+				}
+			}
+		});
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	return true;
+}
+
+// *****************************************************************************************
+// Mismatch-tolerant search of short host sequences (e.g. CRISPR spacers) in phages.
+int searchSpacers(
+	const std::string& virPath,
+	const std::string& spacerPath,
+	const std::string& outPath,
+	int numThreads,
+	size_t batchSize,
+	size_t maxDetails,
+	int mismatches,
+	int seedLength) {
+
+	FastaFile spacerFasta;
+	if (!spacerFasta.open(spacerPath)) {
+		cout << "Unable to open spacer file: " << spacerPath << endl;
+		return -1;
+	}
+
+	// by default the longest seed allowing all spacers to be split into regions
+	if (seedLength == 0) {
+		size_t minLength = std::numeric_limits<size_t>::max();
+		for (size_t i = 0; i < spacerFasta.numSubsequences(); ++i) {
+			minLength = std::min(minLength, spacerFasta.getLengths()[i]);
+		}
+		seedLength = (int)std::max<size_t>(SPACER_MIN_SEED, std::min<size_t>(SPACER_MAX_SEED, minLength / (mismatches + 1)));
+	}
+
+	cout << "Finding spacer matches..." << endl
+		<< "mismatches:     " << mismatches << endl
+		<< "seed length:    " << seedLength << endl
+		<< "phage FASTA:    " << virPath << endl
+		<< "spacer FASTA:   " << spacerPath << endl << endl;
+
+	SpacerIndex index;
+	index.build(spacerFasta, mismatches, seedLength);
+	cout << "Indexed " << index.numIndexed() << " spacers (" << index.numSeeds() << " seeds)";
+	if (index.numSkipped()) {
+		cout << ", " << index.numSkipped() << " skipped (length outside " << (mismatches + 1) * seedLength << "-" << SPACER_MAX_LENGTH << ")";
+	}
+	cout << endl;
+
+	FastaReader virReader;
+	if (batchSize && !virReader.open(virPath)) {
+		cout << "Unable to open input files" << endl;
+		return -1;
+	}
+
+	ofstream outfile(outPath);
+	outfile << virPath << "," << spacerPath << '\n';
+
+	for (size_t batch_id = 0; ; ++batch_id) {
+		FastaFile virFasta;
+		bool loaded = batchSize
+			? virReader.readBatch(batchSize, std::numeric_limits<size_t>::max(), virFasta)
+			: batch_id == 0 && virFasta.open(virPath);
+
+		if (!loaded) {
+			if (batch_id == 0) {
+				cout << "Unable to open input files" << endl;
+				return -1;
+			}
+			break;
+		}
+
+		if (batchSize) {
+			cout << "\rBatch " << batch_id + 1 << " (" << virFasta.numSubsequences() << " records)..." << std::flush;
+		}
+
+		matchSpacers(virFasta, spacerFasta, index, numThreads, maxDetails, outfile);
+		outfile.flush();
+	}
+
+	if (batchSize) {
+		cout << " [OK]" << endl;
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
+
+	cout << "PHIST-Matcher utility 1.0.0" << endl
+		<< "A.Zielezinski, S. Deorowicz, A. Gudys (c) 2021" << endl << endl;
+	
+	std::vector<std::string> params(argc - 1);
+	std::transform(argv + 1, argv + argc, params.begin(), [](char* s)->string { return s; });
+
+	int k;
+	if (!findOption(params, "-k", k)) {
+		k = 25;
+	}
+
+	int numThreads;
+	if (!findOption(params, "-t", numThreads)) {
+		numThreads = 1;
+	}
+
+	int ioThreads;
+	if (!findOption(params, "-io-threads", ioThreads)) {
+		ioThreads = 2;
+	}
+
+	size_t prefetch;
+	if (!findOption(params, "-prefetch", prefetch)) {
+		prefetch = 4;
+	}
+
+	size_t prefetchMem;
+	if (!findOption(params, "-prefetch-mem", prefetchMem)) {
+		prefetchMem = 1024;
+	}
+
+	size_t batchSize;
+	if (!findOption(params, "-batch", batchSize)) {
+		batchSize = 0;
+	}
+
+	size_t groupMem;
+	if (!findOption(params, "-group-mem", groupMem)) {
+		groupMem = 4096;
+	}
+
+	IndexingParams ip;
+	ip.k = k;
+	
+	if (!findOption(params, "-max-occ", ip.maxOccurrences)) {
+		ip.maxOccurrences = 0;
+	}
+
+	if (!findOption(params, "-dust", ip.dustThreshold)) {
+		ip.dustThreshold = 0;
+	}
+
+	std::string engine;
+	if (!findOption(params, "-engine", engine)) {
+		engine = "hash";
+	}
+	ip.suffixArray = (engine == "sa");
+
+	std::string summaryPath;
+	findOption(params, "-summary", summaryPath);
+
+	size_t maxDetails;
+	if (!findOption(params, "-max-matches", maxDetails)) {
+		maxDetails = std::numeric_limits<size_t>::max();
+	}
+
+	bool hostList = findSwitch(params, "-list");
+	bool packed = findSwitch(params, "-packed");
+	bool numaAware = findSwitch(params, "-numa");
+	bool spacerMode = findSwitch(params, "-spacers");
+	
+	int mismatches;
+	if (!findOption(params, "-mismatches", mismatches)) {
+		mismatches = 1;
+	}
+
+	int seedLength;
+	if (!findOption(params, "-seed", seedLength)) {
+		seedLength = 0;
+	}
+
+	if (params.size() != 3) {
+		cout << "USAGE:" << endl
+			<< "matcher [options] <phage> <host> <matches>" << endl << endl
+			<< "Parameters:" << endl
+			<< "\tphage - phage FASTA file (gzipped or not)" << endl
+			<< "\thost - host FASTA file (gzipped or not), a list of host FASTA files (with -list switch), or a host archive" << endl
+			<< "\tmatches - CSV table with all exact matches" << endl << endl
+			<< "Options:" << endl
+			<< "\t-k <length> - minimum match length (25 by default)" << endl
+			<< "\t-list - host parameter is a text file with host FASTA paths (one per line)" << endl
+			<< "\t-t <threads> - number of threads matching hosts (1 by default)" << endl
+			<< "\t-io-threads <threads> - number of threads loading host files (2 by default)" << endl
+			<< "\t-prefetch <count> - maximum number of host files loaded in advance (4 by default)" << endl
+			<< "\t-prefetch-mem <MB> - memory limit for host files loaded in advance (1024 by default)" << endl
+			<< "\t-batch <count> - process phage records in batches of given size (whole file by default); hosts are" << endl
+			<< "\t   loaded in groups matched against all batches, so matches of a host are stored in sections (one per" << endl
+			<< "\t   batch, each starting with the header line) ordered by host group, batch, and host" << endl
+			<< "\t-group-mem <MB> - with -batch, memory limit for a group of loaded hosts (4096 by default)" << endl
+			<< "\t-packed - keep loaded hosts in 2-bit representation (4 times less memory)" << endl
+			<< "\t-max-occ <count> - do not index host k-mers occurring more times (no limit by default)" << endl
+			<< "\t-dust <threshold> - mask low-complexity host regions with DUST score above threshold (e.g. 20, no masking by default)" << endl
+			<< "\t-summary <file> - store per phage record and host aggregates in a CSV file" << endl
+			<< "\t-max-matches <count> - store at most given number of matches per phage record and host (no limit by default)" << endl
+			<< "\t-numa - bind matching threads to NUMA nodes (round robin) and replicate phage k-mers on every node" << endl
+			<< "\t-engine <hash|sa> - find matches with a k-mer index of the host (hash, default) or with a suffix array of the host (sa)" << endl << endl
+			<< "Spacer mode (host is a FASTA file with short sequences, e.g. CRISPR spacers):" << endl
+			<< "\t-spacers - find spacer occurrences in phages (both strands) with mismatches; the output has an extra column with the number of mismatches" << endl
+			<< "\t-mismatches <count> - maximum number of mismatches (1 by default)" << endl
+			<< "\t-seed <length> - length of exact seeds (" << SPACER_MIN_SEED << "-" << SPACER_MAX_SEED 
+			<< ", by default the longest allowing the shortest spacer to be split into mismatches + 1 seeds)" << endl
+			<< "\t-t, -batch, and -max-matches options apply" << endl;
+		return 0;
+	}
+
+	if (engine != "hash" && engine != "sa") {
+		cout << "Unknown matching engine: " << engine << endl;
+		return -1;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const std::string& virPath = params[0];
+	const std::string& hostPath = params[1];
+
+	if (spacerMode) {
+		if (mismatches < 0 || (seedLength != 0 && (seedLength < SPACER_MIN_SEED || seedLength > SPACER_MAX_SEED))) {
+			cout << "Invalid spacer search parameters" << endl;
+			return -1;
+		}
+
+		int ret = searchSpacers(virPath, hostPath, params[2], numThreads, batchSize, maxDetails, mismatches, seedLength);
+		auto time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start);
+		cout << "Finished in " << time.count() << " seconds" << endl;
+		return ret;
+	}
+
+	std::vector<std::string> hostPaths;
+	FastaArchive hostArchive;
+	bool archived = FastaArchive::isArchive(hostPath);
+	
+	if (archived) {
+		if (!hostArchive.open(hostPath)) {
+			cout << "Unable to open host archive: " << hostPath << endl;
+			return -1;
+		}
+	}
+	else if (hostList) {
+		if (!loadList(hostPath, hostPaths)) {
+			cout << "Unable to open host list: " << hostPath << endl;
+			return -1;
+		}
+	}
+	else {
+		hostPaths.push_back(hostPath);
+	}
+
+	cout << "Finding exact matches..." << endl
+		<< "minimum length: " << k << endl
+		<< "engine:         " << (ip.suffixArray ? "suffix array" : "k-mer index") << endl
+		<< "phage FASTA:    " << virPath << endl
+		<< "host FASTA:     " << hostPath << endl  << endl;
+
+	std::unique_ptr<NumaTopology> numa;
+	if (numaAware) {
+		numa.reset(new NumaTopology());
+		cout << "NUMA nodes: " << numa->numNodes() << endl;
+	}
+
+	ofstream outfile(params[2]);
+	
+	std::unique_ptr<ofstream> summaryFile;
+	if (summaryPath.size()) {
+		summaryFile.reset(new ofstream(summaryPath));
+		*summaryFile << "phage,host,#matches-fwd,#matches-rev,covered-bases,longest-match,#host-regions,host-covered-bases" << '\n';
+	}
+
+	// start loading hosts in the background (archived hosts are always packed)
+	std::unique_ptr<FastaLoader> hostLoader(archived
+		? new FastaLoader(hostArchive, ioThreads, prefetch, prefetchMem << 20)
+		: new FastaLoader(hostPaths, ioThreads, prefetch, prefetchMem << 20, packed));
+	bool allOk = true;
+	IndexingStats stats;
+
+	if (batchSize == 0) {
+		FastaFile virFasta;
+		if (!virFasta.open(virPath)) {
+			cout << "Unable to open input files" << endl;
+			return -1;
+		}
+
+		allOk = matchHosts(virPath, virFasta, *hostLoader, nullptr, ip, numThreads, numa.get(), maxDetails, stats, outfile, summaryFile.get());
+	}
+	else {
+		// hosts are read once: every group of loaded hosts is matched against all batches
+		bool hostsLeft = true;
+		for (size_t group_id = 0; hostsLeft; ++group_id) {
+			HostGroup group;
+			size_t groupBytes = 0;
+			size_t host_id;
+			std::unique_ptr<FastaFile> hostFasta;
+			bool ok;
+
+			while (groupBytes < (groupMem << 20) && (hostsLeft = hostLoader->pop(host_id, hostFasta, ok))) {
+				if (!ok) {
+					cout << "Unable to open host file: " << hostLoader->getPath(host_id) << endl;
+					allOk = false;
+					continue;
+				}
+				groupBytes += hostFasta->memoryUsage();
+				group.ids.push_back(host_id);
+				group.files.push_back(std::move(hostFasta));
+			}
+
+			if (group.files.empty()) {
+				continue;
+			}
+
+			FastaReader virReader;
+			if (!virReader.open(virPath)) {
+				cout << "Unable to open input files" << endl;
+				return -1;
+			}
+
+			for (size_t batch_id = 0; ; ++batch_id) {
+				FastaFile virFasta;
+				if (!virReader.readBatch(batchSize, std::numeric_limits<size_t>::max(), virFasta)) {
+					if (batch_id == 0) {
+						cout << "Unable to open input files" << endl;
+						return -1;
+					}
+					break;
+				}
+
+				cout << "\rHost group " << group_id + 1 << " (" << group.files.size() << " hosts), batch " 
+					<< batch_id + 1 << " (" << virFasta.numSubsequences() << " records)..." << std::flush;
+
+				allOk &= matchHosts(virPath, virFasta, *hostLoader, &group, ip, numThreads, numa.get(), maxDetails, stats, outfile, summaryFile.get());
+
+				// make results of the batch available
+				outfile.flush();
+				if (summaryFile) {
+					summaryFile->flush();
+				}
+			}
+		}
+
+		cout << " [OK]" << endl;
+	}
 
 	outfile.close();
 
+	if (ip.dustThreshold > 0) {
+		cout << "Low-complexity masking: " << stats.maskedBases << " host bases masked";
+		if (!ip.suffixArray) {
+			cout << ", " << stats.maskedKmers << " k-mer occurrences suppressed";
+		}
+		cout << endl;
+	}
+	if (ip.maxOccurrences > 0) {
+		cout << "Occurrence cap: " << stats.cappedKmers << " k-mers (" 
+			<< stats.cappedOccurrences << " occurrences) suppressed" << endl;
+	}
+
 	auto time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start);
 	cout << "Finished in " << time.count() << " seconds" << endl;
 
-	return 0;
+	return allOk ? 0 : -1;
 }
 
 
@@ -0,0 +1,144 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "numa.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// *****************************************************************************************
+// Parses a list in sysfs format, e.g. "0-3,8-11".
+static std::vector<int> parseRangeList(const std::string& list) {
+	std::vector<int> out;
+	std::istringstream iss(list);
+	std::string range;
+
+	while (std::getline(iss, range, ',')) {
+		if (range.empty()) {
+			continue;
+		}
+		size_t dash = range.find('-');
+		int first = std::atoi(range.c_str());
+		int last = (dash == std::string::npos) ? first : std::atoi(range.c_str() + dash + 1);
+		for (int i = first; i <= last; ++i) {
+			out.push_back(i);
+		}
+	}
+
+	return out;
+}
+
+// *****************************************************************************************
+//
+NumaTopology::NumaTopology() {
+
+#ifdef __linux__
+	const std::string root = "/sys/devices/system/node/";
+	std::string line;
+
+	std::ifstream online(root + "online");
+	if (online && std::getline(online, line)) {
+		for (int node : parseRangeList(line)) {
+			std::ifstream cpulist(root + "node" + std::to_string(node) + "/cpulist");
+			std::vector<int> cpus;
+			if (cpulist && std::getline(cpulist, line)) {
+				cpus = parseRangeList(line);
+			}
+
+			// memory-only nodes cannot run threads
+			if (cpus.size()) {
+				nodeIds.push_back(node);
+				nodeCpus.push_back(cpus);
+			}
+		}
+	}
+#endif
+
+	if (nodeCpus.empty()) {
+		nodeIds.push_back(0);
+		nodeCpus.emplace_back();
+	}
+}
+
+// *****************************************************************************************
+//
+bool NumaTopology::bindCurrentThread(size_t node) const {
+
+#ifdef __linux__
+	const std::vector<int>& cpus = nodeCpus[node];
+	if (cpus.empty()) {
+		return false;
+	}
+
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	for (int cpu : cpus) {
+		CPU_SET(cpu, &mask);
+	}
+
+	return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+	return false;
+#endif
+}
+
+// *****************************************************************************************
+// Sums pages of all mappings per node from /proc/self/numa_maps (entries N<node>=<pages>).
+std::vector<size_t> NumaTopology::processMemoryPerNode() const {
+
+	std::vector<size_t> usage(nodeIds.size(), 0);
+
+#ifdef __linux__
+	const std::string pageSizeKey = "kernelpagesize_kB=";
+	std::ifstream maps("/proc/self/numa_maps");
+	std::string line, token;
+
+	while (std::getline(maps, line)) {
+		std::istringstream iss(line);
+		size_t pageSize = 4096;
+		std::vector<std::pair<int, size_t>> pages;
+
+		while (iss >> token) {
+			if (token.compare(0, pageSizeKey.size(), pageSizeKey) == 0) {
+				pageSize = std::strtoull(token.c_str() + pageSizeKey.size(), nullptr, 10) * 1024;
+			}
+			else if (token.size() > 1 && token[0] == 'N' && token.find('=') != std::string::npos) {
+				int node = std::atoi(token.c_str() + 1);
+				size_t count = std::strtoull(token.c_str() + token.find('=') + 1, nullptr, 10);
+				pages.emplace_back(node, count);
+			}
+		}
+
+		for (const auto& p : pages) {
+			for (size_t i = 0; i < nodeIds.size(); ++i) {
+				if (nodeIds[i] == p.first) {
+					usage[i] += p.second * pageSize;
+				}
+			}
+		}
+	}
+#endif
+
+	return usage;
+}
@@ -0,0 +1,47 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include <vector>
+#include <cstddef>
+
+// *****************************************************************************************
+// NUMA nodes of the machine with their CPUs (read from sysfs on Linux). Threads bound to
+// a node allocate memory from that node on first touch, which allows keeping read-mostly
+// data local to the threads using it. On other platforms (or when the topology cannot
+// be determined) there is a single node and binding has no effect.
+class NumaTopology {
+public:
+	NumaTopology();
+
+	size_t numNodes() const { return nodeCpus.size(); }
+	const std::vector<int>& getCpus(size_t node) const { return nodeCpus[node]; }
+
+	// node for the given worker (workers are distributed evenly over nodes)
+	size_t nodeForWorker(size_t workerId) const { return workerId % nodeCpus.size(); }
+
+	// restricts the calling thread to CPUs of the node, returns false on failure
+	bool bindCurrentThread(size_t node) const;
+
+	// memory of the current process resident on each node (in bytes)
+	std::vector<size_t> processMemoryPerNode() const;
+
+protected:
+	std::vector<int> nodeIds;
+	std::vector<std::vector<int>> nodeCpus;
+};
@@ -0,0 +1,59 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "packed_sequence.h"
+#include "kmer_helper.h"
+
+// *****************************************************************************************
+//
+void PackedSequence::pack(const char* sequence, size_t length) {
+
+	const char* map = get_symbol_map();
+
+	this->length = length;
+	words.assign((length + 31) / 32, 0);
+	ambiguous.clear();
+
+	for (size_t i = 0; i < length; ++i) {
+		char symb = map[static_cast<unsigned char>(sequence[i])];
+
+		if (symb < 0) {
+			// extend previous run or start a new one
+			if (ambiguous.size() && ambiguous.back().first + ambiguous.back().second == i) {
+				++ambiguous.back().second;
+			}
+			else {
+				ambiguous.emplace_back((uint32_t)i, 1);
+			}
+			symb = 0;
+		}
+
+		words[i >> 5] |= (uint64_t)symb << ((i & 31) << 1);
+	}
+
+	words.shrink_to_fit();
+	ambiguous.shrink_to_fit();
+}
+
+// *****************************************************************************************
+//
+void PackedSequence::assign(const uint64_t* words, size_t length, const Run* runs, size_t numRuns) {
+	this->length = length;
+	this->words.assign(words, words + (length + 31) / 32);
+	ambiguous.assign(runs, runs + numRuns);
+}
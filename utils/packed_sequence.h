@@ -0,0 +1,54 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+// *****************************************************************************************
+// Nucleotide sequence with 2 bits per base (A=0, C=1, G=2, T=3, 32 bases per word,
+// first base in the least significant bits). Non-ACGT symbols are stored as A and
+// their positions are kept as a list of runs.
+class PackedSequence {
+public:
+	typedef std::pair<uint32_t, uint32_t> Run; // start, length
+
+	PackedSequence() : length(0) {}
+
+	void pack(const char* sequence, size_t length);
+
+	// sets an already packed sequence (e.g. read from an archive)
+	void assign(const uint64_t* words, size_t length, const Run* runs, size_t numRuns);
+
+	size_t numWords() const { return words.size(); }
+
+	size_t size() const { return length; }
+	const uint64_t* data() const { return words.data(); }
+	const std::vector<Run>& getAmbiguousRuns() const { return ambiguous; }
+
+	uint8_t symbol(size_t i) const { return (words[i >> 5] >> ((i & 31) << 1)) & 3; }
+
+	size_t memoryUsage() const { return words.size() * sizeof(uint64_t) + ambiguous.size() * sizeof(Run); }
+
+protected:
+	std::vector<uint64_t> words;
+	size_t length;
+	std::vector<Run> ambiguous;
+};
@@ -0,0 +1,81 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+
+
+inline bool findSwitch(std::vector<std::string>& params, const std::string& name) {
+	auto it = find(params.begin(), params.end(), name); // verbose mode
+	if (it != params.end()) {
+		params.erase(it);
+		return true;
+	}
+
+	return false;
+}
+
+template <typename T>
+bool findOption(std::vector<std::string>& params, const std::string& name, T& v) {
+	if (params.empty()) {
+		return false;
+	}
+
+	auto prevToEnd = std::prev(params.end());
+	auto it = find(params.begin(), prevToEnd, name); // verbose mode
+	if (it != prevToEnd) {
+		std::istringstream iss(*std::next(it));
+		if (iss >> v) {
+			params.erase(it, it + 2);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// reads non-empty lines of a list file (e.g. paths to FASTA files)
+inline bool loadList(const std::string& path, std::vector<std::string>& items) {
+	std::ifstream listFile(path);
+	if (!listFile) {
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(listFile, line)) {
+		if (line.size() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.size()) {
+			items.push_back(line);
+		}
+	}
+
+	return true;
+}
+
+// file name without a directory (used as a sample name, as in kmer-db)
+inline std::string getFileName(const std::string& path) {
+	size_t pos = path.find_last_of("/\\");
+	return pos == std::string::npos ? path : path.substr(pos + 1);
+}
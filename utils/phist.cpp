@@ -18,6 +18,9 @@ program. If not, see https://www.gnu.org/licenses/.
 ******************************************************************************/
 
 
+#include "prediction.h"
+#include "params.h"
+
 #include <iostream>
 #include <vector>
 #include <string>
@@ -26,6 +29,7 @@ program. If not, see https://www.gnu.org/licenses/.
 #include <chrono>
 #include <cmath>
 #include <iomanip>
+#include <cstdio>
 
 
 using namespace std;
@@ -58,68 +62,29 @@ long int strtol(const char* str, char** endptr)
 
 
 
-struct Organism {
-public:
-	string name;
-	uint32_t kmer_count;
-
-	template<class Iterator>
-	Organism(Iterator name_begin, Iterator name_end) : name(name_begin, name_end), kmer_count(0) {}
-};
-
-struct Hit {
-	uint32_t host_id;
-	uint32_t common_kmers;
-	
-	Hit(uint32_t host_id, uint32_t common_kmers) : host_id(host_id), common_kmers(common_kmers) {}
-
-};
-
-struct Phage : public Organism {
-public:
-	
-
-	std::vector<Hit> hits;
-
-	template<class Iterator>
-	Phage(Iterator name_begin, Iterator name_end) : Organism(name_begin, name_end) {}
-};
-
-
-int main(int argc, char** argv) {
-	
-	cout << "PHIST utility 1.0.0" << endl
-		<< "A.Zielezinski, S. Deorowicz, A. Gudys (c) 2021" << endl << endl;
-	
-	vector<string> params;
-	
-	for (int i = 1; i < argc; ++i) {
-		params.push_back(argv[i]);
-	}
-
-	if (params.size() != 2) {
-		cout << "USAGE:" << endl
-			<< "phist <input> <output>" << endl << endl
-			<< "Parameters:" << endl
-			<< "\tinput - CSV file in a sparse format with a number of common k-mers between phages and bacteria" << endl
-			<< "\t        (result of running `kmer-db new2all -sparse phages.db bacteria.list`)," << endl
-			<< "\toutput - CSV file with assignments of phages to their most probable hosts" << endl;
-	}
+// *****************************************************************************************
+// Parses a sparse table produced by kmer-db new2all and updates the best hits of phages.
+// The first table defines the phages, every subsequent one (a partial table for another 
+// shard of hosts) must have the same header. Hosts are numbered globally across tables:
+// bacteria are appended to the collection and numbered from first_bact_id + its size.
+bool processTable(
+	const string& path,
+	char* line,
+	size_t bufsize,
+	uint32_t& k,
+	vector<Phage>& phages,
+	vector<Organism>& bacteria,
+	uint32_t first_bact_id) {
 
-	auto start = std::chrono::high_resolution_clock::now();
-	
-	ifstream input(params[0]);
+	ifstream input(path);
 
 	if (!input) {
-		return 0;
+		cout << "Unable to open " << path << endl;
+		return false;
 	}
 
-	size_t bufsize = 1 << 30; // 1 GB line buffer
-	char* line = new char[bufsize]; 
-
-	vector<Phage> phages;
-	vector<Organism> bacteria;
-
+	bool first = phages.empty();
+	
 	//
 	// Extract phages names
 	//
@@ -130,19 +95,40 @@ int main(int argc, char** argv) {
 	char * begin = line;
 	char * p = std::find(begin, end, ':');
 	begin = p+2;
-	uint32_t k = strtol(begin, &p);
+	uint32_t table_k = strtol(begin, &p);
+
+	if (first) {
+		k = table_k;
+	}
+	else if (table_k != k) {
+		cout << "Error: k-mer length in " << path << " differs from the one in the first table" << endl;
+		return false;
+	}
 
 	begin = line;
 	p = std::find(begin, end, ',');
 	p = std::find(p + 1, end, ',');
 
 	begin = p + 1;
+	size_t phage_id = 0;
 	do {
 		p = std::find(begin, end, ',');
-		phages.emplace_back(begin, p);
+		if (first) {
+			phages.emplace_back(begin, p);
+		}
+		else if (phage_id >= phages.size() || phages[phage_id].name.compare(0, string::npos, begin, p - begin) != 0) {
+			cout << "Error: phages in " << path << " differ from those in the first table" << endl;
+			return false;
+		}
+		++phage_id;
 		begin = p + 1;
 	} while (end - begin > 1);
 
+	if (phage_id != phages.size()) {
+		cout << "Error: phages in " << path << " differ from those in the first table" << endl;
+		return false;
+	}
+
 	//
 	// Extract phages k-mers count
 	// 
@@ -156,7 +142,7 @@ int main(int argc, char** argv) {
 	
 	begin = p + 1;
 	p = end;
-	int phage_id = 0;
+	phage_id = 0;
 	do {
 		phages[phage_id].kmer_count = strtol(begin, &p); // assume no white characters after the number -> p points comma
 		++phage_id;
@@ -166,9 +152,9 @@ int main(int argc, char** argv) {
 	//
 	// Process bacteria
 	//
-	cout << "Processing bacteria from Kmer-db table..." << endl;
+	cout << "Processing bacteria from Kmer-db table " << path << "..." << endl;
 
-	uint32_t bact_id = 0;
+	uint32_t bact_id = first_bact_id + (uint32_t)bacteria.size();
 	while (input.getline(line, bufsize)) {
 		// show progress
 		if ((bact_id + 1) % 10 == 0) {
@@ -200,64 +186,339 @@ int main(int argc, char** argv) {
 			uint32_t common_kmers = strtol(begin, &p); // assume no white characters after number -> p points comma
 			begin = p + 1;
 
-			if (phage.hits.empty() || common_kmers == phage.hits.front().common_kmers) {
-				// empty collection or same as current best - add new 
-				phage.hits.emplace_back(bact_id, common_kmers);
-			}
-			else if (common_kmers > phage.hits.front().common_kmers) {
-				// better then current best - replace
-				phage.hits.clear();
-				phage.hits.emplace_back(bact_id, common_kmers);
-			}
-			
-
+			phage.addHit(bact_id, common_kmers);
 		}
 
 		++bact_id;
 	}
 	cout << "\r" << bact_id << " [OK]" << endl;
 	input.close();
-	
-	//
-	// Store results
-	// 
-	ofstream output(params[1]);
 
-	output << "phage,host,#common-kmers,pvalue,adj-pvalue" << endl;
+	return true;
+}
+
 
-	for (Phage& ph : phages) {
-		
-		// no host
-		if (ph.hits.empty()) {
-			output << ph.name << endl;
+// *****************************************************************************************
+// Reduction state of an earlier run. It is an append-only journal: the header with the k-mer 
+// length and phages is followed by a record per merged table with the number of bacteria it 
+// added and the best hits of phages which changed. Bacteria (needed only for storing 
+// predictions) are appended to a separate file <state>.bacteria. Thus, merging a table costs
+// only the size of the table, not of the state. A record is valid only when complete, so an
+// interrupted run leaves the state of the last merged table.
+struct State {
+	uint32_t k;
+	vector<string> tables;
+	uint32_t num_bacteria;		// bacteria in all merged tables
+	uint64_t valid_bytes;		// journal size up to the last complete record
+	uint64_t bacteria_bytes;	// bacteria file size for the last complete record
+
+	State() : k(0), num_bacteria(0), valid_bytes(0), bacteria_bytes(0) {}
+};
+
+// *****************************************************************************************
+// Truncates a file to the given size by copying (used only after an interruption).
+bool truncateFile(const string& path, uint64_t size) {
+	string tmpPath = path + ".tmp";
+	{
+		ifstream input(path, ios::binary);
+		ofstream output(tmpPath, ios::binary);
+		vector<char> buffer(1 << 20);
+		while (size > 0 && input) {
+			input.read(buffer.data(), (streamsize)std::min<uint64_t>(size, buffer.size()));
+			output.write(buffer.data(), input.gcount());
+			size -= input.gcount();
 		}
-		else {
-			// sort increasingly by the host length
-			std::stable_sort(ph.hits.begin(), ph.hits.end(), [&bacteria](const Hit& h1, const Hit& h2)->bool {
-				return bacteria[h1.host_id].kmer_count < bacteria[h2.host_id].kmer_count;
-			});
+		if (!output) {
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	std::remove(path.c_str()); // rename does not overwrite on Windows
+#endif
+	return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// *****************************************************************************************
+//
+uint64_t fileSize(const string& path) {
+	ifstream input(path, ios::binary | ios::ate);
+	return input ? (uint64_t)input.tellg() : 0;
+}
+
+// *****************************************************************************************
+// Loads the state: phages with their current best hits and, if requested, all bacteria (so 
+// that host identifiers and the multiple testing correction are preserved). Leftovers of an 
+// interrupted update are removed.
+bool loadState(
+	const string& path,
+	State& state,
+	vector<Phage>& phages,
+	vector<Organism>* bacteria) {
+
+	ifstream input(path, ios::binary);
+	string tag, name;
+	size_t count;
+	uint32_t kmer_count;
+
+	// the header is written together with the first record (an empty file is no state)
+	if ((input >> tag) && (tag != "PHIST-state" || !(input >> tag) || tag != "2")) {
+		cout << "Error: " << path << " is not a valid state file" << endl;
+		return false;
+	}
+
+	input >> tag >> state.k >> tag >> count;
+	for (size_t i = 0; i < count && input >> kmer_count; ++i) {
+		input.ignore();
+		getline(input, name);
+		phages.emplace_back(name, kmer_count);
+	}
+
+	// replay complete records
+	vector<pair<size_t, vector<Hit>>> updates;
+	while (input >> tag && tag == "table") {
+		string table;
+		uint32_t added;
+		uint64_t bacteria_bytes;
+		size_t num_updates;
+
+		input.ignore();
+		getline(input, table);
+		input >> tag >> added >> bacteria_bytes >> tag >> num_updates;
+
+		updates.clear();
+		for (size_t i = 0; i < num_updates && input; ++i) {
+			size_t phage_id, num_hits;
+			input >> phage_id >> num_hits;
+			updates.emplace_back(phage_id, vector<Hit>());
 			
-			for (const auto& hit : ph.hits) {
-				
-				const Organism& host = bacteria[hit.host_id];
-				int len_common = hit.common_kmers + k - 1;
-				int len_host = host.kmer_count + k - 1;
-				int len_phage = ph.kmer_count + k - 1;
-				
-				long double num_canonical = (len_common % 2)
-					? pow(4, len_common) / 2
-					: (pow(4, len_common) + pow(4, len_common / 2)) / 2;
-
-				long double lambda = (double)(len_host - len_common + 1) * (len_phage - len_common + 1) / num_canonical;
-				long double pval = 1 - std::exp(-lambda);
-				
-				// adjust by the number of potential hosts
-				long double adj_pval = std::min(bact_id * pval, (long double)1.0);
-
-				output << ph.name << ',' << bacteria[hit.host_id].name << ',' << hit.common_kmers << ',' << std::scientific << pval << "," << adj_pval << endl;
+			uint32_t host_id, common_kmers;
+			for (size_t j = 0; j < num_hits && input >> host_id >> common_kmers; ++j) {
+				updates.back().second.emplace_back(host_id, common_kmers);
+			}
+		}
+
+		if (!(input >> tag) || tag != "end" || input.get() != '\n') {
+			break;
+		}
+
+		for (auto& u : updates) {
+			if (u.first < phages.size()) {
+				phages[u.first].hits = std::move(u.second);
 			}
 		}
+		state.tables.push_back(table);
+		state.num_bacteria += added;
+		state.bacteria_bytes = bacteria_bytes;
+		state.valid_bytes = (uint64_t)input.tellg();
 	}
+	input.close();
+
+	// interrupted before completing the first record
+	if (state.tables.empty()) {
+		state = State();
+		phages.clear();
+	}
+
+	string bacteriaPath = path + ".bacteria";
+	if ((fileSize(path) > state.valid_bytes && !truncateFile(path, state.valid_bytes))
+		|| (fileSize(bacteriaPath) > state.bacteria_bytes && !truncateFile(bacteriaPath, state.bacteria_bytes))) {
+		cout << "Error: unable to repair state file " << path << endl;
+		return false;
+	}
+
+	if (bacteria) {
+		ifstream bactInput(bacteriaPath, ios::binary);
+		for (uint32_t i = 0; i < state.num_bacteria && bactInput >> kmer_count; ++i) {
+			bactInput.ignore();
+			getline(bactInput, name);
+			bacteria->emplace_back(name, kmer_count);
+		}
+
+		if (bacteria->size() != state.num_bacteria) {
+			cout << "Error: bacteria file " << bacteriaPath << " is truncated" << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// *****************************************************************************************
+// Appends the record of a merged table: bacteria added by the table and phages whose best 
+// hits changed. The journal header is written with the first record.
+bool appendState(
+	const string& path,
+	State& state,
+	const string& table,
+	const vector<Phage>& phages,
+	const vector<size_t>& changed,
+	vector<Organism>::const_iterator newBegin,
+	vector<Organism>::const_iterator newEnd) {
+
+	string bacteriaPath = path + ".bacteria";
+	{
+		ofstream output(bacteriaPath, ios::binary | ios::app);
+		for (auto it = newBegin; it != newEnd; ++it) {
+			output << it->kmer_count << ' ' << it->name << '\n';
+		}
+		if (!output) {
+			cout << "Error: unable to store state in " << bacteriaPath << endl;
+			return false;
+		}
+	}
+
+	ofstream output(path, ios::binary | ios::app);
+	if (state.tables.empty()) {
+		output << "PHIST-state 2" << '\n'
+			<< "k " << state.k << '\n'
+			<< "phages " << phages.size() << '\n';
+		for (const auto& ph : phages) {
+			output << ph.kmer_count << ' ' << ph.name << '\n';
+		}
+	}
+
+	uint32_t added = (uint32_t)(newEnd - newBegin);
+	uint64_t bacteria_bytes = fileSize(bacteriaPath);
+	
+	output << "table " << table << '\n'
+		<< "bacteria " << added << ' ' << bacteria_bytes << '\n'
+		<< "hits " << changed.size() << '\n';
+	for (size_t phage_id : changed) {
+		const auto& hits = phages[phage_id].hits;
+		output << phage_id << ' ' << hits.size();
+		for (const auto& h : hits) {
+			output << ' ' << h.host_id << ' ' << h.common_kmers;
+		}
+		output << '\n';
+	}
+	output << "end" << '\n';
+	output.close();
+	
+	if (!output) {
+		cout << "Error: unable to store state in " << path << endl;
+		return false;
+	}
+
+	state.tables.push_back(table);
+	state.num_bacteria += added;
+	state.bacteria_bytes = bacteria_bytes;
+	state.valid_bytes = fileSize(path);
+	return true;
+}
+
+
+int main(int argc, char** argv) {
+	
+	cout << "PHIST utility 1.0.0" << endl
+		<< "A.Zielezinski, S. Deorowicz, A. Gudys (c) 2021" << endl << endl;
+	
+	vector<string> params;
+	
+	for (int i = 1; i < argc; ++i) {
+		params.push_back(argv[i]);
+	}
+
+	string statePath;
+	findOption(params, "-state", statePath);
+	bool stateOnly = findSwitch(params, "-state-only") && statePath.size();
+
+	if (params.size() < (statePath.empty() ? 2u : 1u)) {
+		cout << "USAGE:" << endl
+			<< "phist [-state <file> [-state-only]] <input_1> [<input_2> ...] <output>" << endl << endl
+			<< "Parameters:" << endl
+			<< "\tinput - CSV file in a sparse format with a number of common k-mers between phages and bacteria" << endl
+			<< "\t        (result of running `kmer-db new2all -sparse phages.db bacteria.list`)," << endl
+			<< "\t        multiple tables for disjoint sets of bacteria (same phage database) are merged," << endl
+			<< "\toutput - CSV file with assignments of phages to their most probable hosts" << endl << endl
+			<< "Options:" << endl
+			<< "\t-state <file> - resume from the state of an earlier run (if the file exists) and update" << endl
+			<< "\t                the state after every input; inputs already merged are skipped" << endl
+			<< "\t-state-only - only update the state with the inputs (there is no output parameter)" << endl;
+		return 0;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	
+	size_t bufsize = 1 << 30; // 1 GB line buffer
+	char* line = new char[bufsize]; 
+
+	vector<Phage> phages;
+	vector<Organism> bacteria;
+	State state;
+
+	// bacteria of the state are not needed when only the state is updated
+	if (statePath.size() && ifstream(statePath)) {
+		if (!loadState(statePath, state, phages, stateOnly ? nullptr : &bacteria)) {
+			delete[] line;
+			return -1;
+		}
+		cout << "Resuming from " << statePath << " (" << state.tables.size() << " tables, " 
+			<< state.num_bacteria << " bacteria merged)" << endl;
+	}
+
+	uint32_t k = state.k;
+	uint32_t first_bact_id = stateOnly ? state.num_bacteria : 0;
+	size_t numInputs = stateOnly ? params.size() : params.size() - 1;
+
+	for (size_t i = 0; i < numInputs; ++i) {
+		if (std::find(state.tables.begin(), state.tables.end(), params[i]) != state.tables.end()) {
+			cout << "Table " << params[i] << " already merged - skipped" << endl;
+			continue;
+		}
+
+		// phages are compared before and after the table to find changed best hits
+		vector<pair<size_t, uint32_t>> before(phages.size());
+		for (size_t j = 0; j < phages.size(); ++j) {
+			before[j].first = phages[j].hits.size();
+			before[j].second = phages[j].hits.empty() ? 0 : phages[j].hits.front().common_kmers;
+		}
+		size_t numBefore = bacteria.size();
+
+		if (!processTable(params[i], line, bufsize, k, phages, bacteria, first_bact_id)) {
+			delete[] line;
+			return -1;
+		}
+
+		if (statePath.size()) {
+			vector<size_t> changed;
+			for (size_t j = 0; j < phages.size(); ++j) {
+				if (j >= before.size() || phages[j].hits.size() != before[j].first 
+					|| (phages[j].hits.size() && phages[j].hits.front().common_kmers != before[j].second)) {
+					changed.push_back(j);
+				}
+			}
+
+			state.k = k;
+			if (!appendState(statePath, state, params[i], phages, changed, bacteria.begin() + numBefore, bacteria.end())) {
+				delete[] line;
+				return -1;
+			}
+		}
+
+		// with the state only updated, bacteria are not kept in memory
+		if (stateOnly) {
+			first_bact_id += (uint32_t)bacteria.size();
+			bacteria.clear();
+		}
+	}
+
+	if (stateOnly) {
+		delete[] line;
+		auto time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start);
+		cout << "State updated in " << time.count() << " seconds" << endl;
+		return 0;
+	}
+
+	// multiple testing correction over all bacteria from all tables
+	uint32_t bact_id = bacteria.size();
+	
+	//
+	// Store results
+	// 
+	ofstream output(params.back());
+
+	storePredictions(output, phages, bacteria, bact_id, k);
 
 	//
 	output.close();
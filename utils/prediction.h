@@ -0,0 +1,158 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <ios>
+#include <ostream>
+#include <algorithm>
+
+
+struct Organism {
+public:
+	std::string name;
+	uint32_t kmer_count;
+
+	template<class Iterator>
+	Organism(Iterator name_begin, Iterator name_end) : name(name_begin, name_end), kmer_count(0) {}
+
+	Organism(const std::string& name, uint32_t kmer_count) : name(name), kmer_count(kmer_count) {}
+};
+
+struct Hit {
+	uint32_t host_id;
+	uint32_t common_kmers;
+
+	Hit(uint32_t host_id, uint32_t common_kmers) : host_id(host_id), common_kmers(common_kmers) {}
+
+};
+
+struct Phage : public Organism {
+public:
+
+
+	std::vector<Hit> hits;
+
+	template<class Iterator>
+	Phage(Iterator name_begin, Iterator name_end) : Organism(name_begin, name_end) {}
+
+	Phage(const std::string& name, uint32_t kmer_count) : Organism(name, kmer_count) {}
+
+	// hosts must be reported in the increasing order of identifiers for ties to be resolved as in phist
+	void addHit(uint32_t host_id, uint32_t common_kmers) {
+		if (hits.empty() || common_kmers == hits.front().common_kmers) {
+			// empty collection or same as current best - add new
+			hits.emplace_back(host_id, common_kmers);
+		}
+		else if (common_kmers > hits.front().common_kmers) {
+			// better then current best - replace
+			hits.clear();
+			hits.emplace_back(host_id, common_kmers);
+		}
+	}
+};
+
+
+// *****************************************************************************************
+// Probability of sharing the given number of k-mers between a phage and a host by chance.
+inline long double computePValue(uint32_t common_kmers, uint32_t host_kmers, uint32_t phage_kmers, uint32_t k) {
+	int len_common = common_kmers + k - 1;
+	int len_host = host_kmers + k - 1;
+	int len_phage = phage_kmers + k - 1;
+
+	long double num_canonical = (len_common % 2)
+		? pow(4, len_common) / 2
+		: (pow(4, len_common) + pow(4, len_common / 2)) / 2;
+
+	long double lambda = (double)(len_host - len_common + 1) * (len_phage - len_common + 1) / num_canonical;
+	return 1 - std::exp(-lambda);
+}
+
+// *****************************************************************************************
+// Predicted host of a phage.
+struct Prediction {
+	uint32_t host_id;
+	uint32_t common_kmers;
+	long double pval;
+	long double adj_pval;
+
+	Prediction(uint32_t host_id, uint32_t common_kmers, long double pval, long double adj_pval) :
+		host_id(host_id), common_kmers(common_kmers), pval(pval), adj_pval(adj_pval) {}
+};
+
+// *****************************************************************************************
+// Computes predictions from the best hits of a phage. Hosts are sorted increasingly by the
+// length, p-values are adjusted by the number of potential hosts.
+inline void computePredictions(
+	Phage& ph,
+	const std::vector<Organism>& bacteria,
+	uint32_t num_hosts,
+	uint32_t k,
+	std::vector<Prediction>& predictions) {
+
+	// sort increasingly by the host length
+	std::stable_sort(ph.hits.begin(), ph.hits.end(), [&bacteria](const Hit& h1, const Hit& h2)->bool {
+		return bacteria[h1.host_id].kmer_count < bacteria[h2.host_id].kmer_count;
+	});
+
+	predictions.clear();
+	for (const auto& hit : ph.hits) {
+		long double pval = computePValue(hit.common_kmers, bacteria[hit.host_id].kmer_count, ph.kmer_count, k);
+
+		// adjust by the number of potential hosts
+		long double adj_pval = std::min(num_hosts * pval, (long double)1.0);
+
+		predictions.emplace_back(hit.host_id, hit.common_kmers, pval, adj_pval);
+	}
+}
+
+// *****************************************************************************************
+// Stores predictions in CSV format. P-values are adjusted by the number of potential hosts.
+inline void storePredictions(
+	std::ostream& output,
+	std::vector<Phage>& phages,
+	const std::vector<Organism>& bacteria,
+	uint32_t num_hosts,
+	uint32_t k) {
+
+	std::ios::fmtflags flags = output.flags();
+	output << "phage,host,#common-kmers,pvalue,adj-pvalue" << '\n';
+
+	std::vector<Prediction> predictions;
+
+	for (Phage& ph : phages) {
+
+		// no host
+		if (ph.hits.empty()) {
+			output << ph.name << '\n';
+		}
+		else {
+			computePredictions(ph, bacteria, num_hosts, k, predictions);
+
+			for (const auto& p : predictions) {
+				output << ph.name << ',' << bacteria[p.host_id].name << ',' << p.common_kmers << ',' << std::scientific << p.pval << "," << p.adj_pval << '\n';
+			}
+		}
+	}
+
+	output.flags(flags);
+	output.flush();
+}
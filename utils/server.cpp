@@ -0,0 +1,555 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_file.h"
+#include "host_db.h"
+#include "fasta_loader.h"
+#include "prediction.h"
+#include "params.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstring>
+#endif
+
+using namespace std;
+
+// *****************************************************************************************
+// Inserts .k<length> before the extension of an output path.
+string outputPathForK(const string& path, uint32_t k) {
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	string suffix = ".k" + std::to_string(k);
+	
+	if (dot == string::npos || (slash != string::npos && dot < slash)) {
+		return path + suffix;
+	}
+	return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// *****************************************************************************************
+// Processes a single request: <phage_path>[\t<output_path>]. Predictions are written to the
+// output file (response: OK) or directly to the response. Every response ends with an empty line.
+void handleRequest(const HostDatabase& db, bool multisample, const string& request, ostream& response) {
+
+	size_t tab = request.find('\t');
+	string phagePath = request.substr(0, tab);
+	string outputPath = (tab == string::npos) ? "" : request.substr(tab + 1);
+
+	FastaFile fasta;
+	if (!fasta.open(phagePath)) {
+		response << "ERROR\tunable to open " << phagePath << "\n\n";
+		return;
+	}
+
+	vector<Phage> phages;
+	vector<kmer_t> kmers;
+	vector<uint32_t> counters;
+	vector<Hit> hits;
+
+	// each record is a separate phage or the entire file is a single phage
+	size_t numPhages = multisample ? fasta.numSubsequences() : 1;
+	for (size_t i = 0; i < numPhages; ++i) {
+		size_t first = multisample ? i : 0;
+		size_t last = multisample ? i + 1 : fasta.numSubsequences();
+
+		HostDatabase::extractUniqueKmers(fasta, first, last, db.getK(), kmers);
+		phages.emplace_back(multisample ? string(fasta.getHeaders()[i]) : getFileName(phagePath), (uint32_t)kmers.size());
+
+		db.query(kmers, counters, hits);
+		for (const Hit& h : hits) {
+			phages.back().addHit(h.host_id, h.common_kmers);
+		}
+	}
+
+	uint32_t numHosts = (uint32_t)db.getHosts().size();
+
+	if (outputPath.empty()) {
+		storePredictions(response, phages, db.getHosts(), numHosts, db.getK());
+		response << '\n';
+	}
+	else {
+		ofstream output(outputPath);
+		if (!output) {
+			response << "ERROR\tunable to create " << outputPath << "\n\n";
+			return;
+		}
+		storePredictions(output, phages, db.getHosts(), numHosts, db.getK());
+		response << "OK\t" << outputPath << "\n\n";
+	}
+}
+
+// *****************************************************************************************
+// Indexes k-mers of phages from the given FASTA files (a database per k-mer length).
+bool indexPhages(const vector<string>& paths, bool multisample, int numThreads, vector<KmerDatabase>& dbs) {
+
+	size_t numK = dbs.size();
+	vector<uint32_t> ks;
+	for (const auto& db : dbs) {
+		ks.push_back(db.getK());
+	}
+
+	// phages of every file: names and k-mers of all lengths
+	vector<vector<string>> names(paths.size());
+	vector<vector<vector<vector<kmer_t>>>> kmers(paths.size());
+
+	std::atomic<size_t> next(0);
+	std::mutex mtx;
+	bool ok = true;
+
+	vector<thread> workers;
+	for (int tid = 0; tid < std::max(1, numThreads); ++tid) {
+		workers.emplace_back([&]() {
+			for (size_t f = next++; f < paths.size(); f = next++) {
+				FastaFile fasta;
+				if (!fasta.open(paths[f])) {
+					std::lock_guard<std::mutex> lck(mtx);
+					cerr << "Unable to open phage file: " << paths[f] << endl;
+					ok = false;
+					continue;
+				}
+
+				// each record is a separate phage or the entire file is a single phage
+				size_t numPhages = multisample ? fasta.numSubsequences() : 1;
+				for (size_t i = 0; i < numPhages; ++i) {
+					size_t first = multisample ? i : 0;
+					size_t last = multisample ? i + 1 : fasta.numSubsequences();
+					names[f].push_back(multisample ? string(fasta.getHeaders()[i]) : getFileName(paths[f]));
+					
+					kmers[f].emplace_back();
+					KmerDatabase::extractUniqueKmers(fasta, first, last, ks, kmers[f].back());
+				}
+			}
+		});
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	if (!ok) {
+		return false;
+	}
+
+	for (size_t j = 0; j < numK; ++j) {
+		vector<Organism> phages;
+		vector<vector<kmer_t>> phageKmers;
+		for (size_t f = 0; f < paths.size(); ++f) {
+			for (size_t i = 0; i < names[f].size(); ++i) {
+				phages.emplace_back(names[f][i], (uint32_t)kmers[f][i][j].size());
+				phageKmers.push_back(std::move(kmers[f][i][j]));
+			}
+		}
+		dbs[j].build(std::move(phages), phageKmers);
+	}
+
+	return true;
+}
+
+// *****************************************************************************************
+// Streams hosts against phage k-mers kept in memory - only one host per thread is resident
+// at a time, thus the collection of hosts may be arbitrarily large. k-mers of all lengths 
+// are extracted from a host in a single scan and counted against the phage database of 
+// the corresponding length. Predictions are the same as in the request mode.
+bool streamHosts(FastaLoader& loader, const vector<KmerDatabase>& dbs, int numThreads, const string& outputPath) {
+
+	size_t numK = dbs.size();
+	size_t numPhages = dbs.front().getOrganisms().size();
+	vector<uint32_t> ks;
+	for (const auto& db : dbs) {
+		ks.push_back(db.getK());
+	}
+
+	// best hosts of phages found by a thread
+	struct Best {
+		uint32_t common_kmers;
+		vector<uint32_t> host_ids;
+
+		Best() : common_kmers(0) {}
+	};
+
+	vector<vector<Organism>> hosts(numK, vector<Organism>(loader.size(), Organism("", 0)));
+	vector<vector<vector<Best>>> best(std::max(1, numThreads));
+	std::mutex mtx;
+	size_t numSkipped = 0;
+
+	vector<thread> workers;
+	for (int tid = 0; tid < std::max(1, numThreads); ++tid) {
+		workers.emplace_back([&](int tid) {
+			auto& local = best[tid];
+			local.assign(numK, vector<Best>(numPhages));
+
+			size_t host_id;
+			std::unique_ptr<FastaFile> fasta;
+			bool loaded;
+			vector<vector<kmer_t>> hostKmers;
+			vector<uint32_t> counters;
+			vector<Hit> hits;
+
+			while (loader.pop(host_id, fasta, loaded)) {
+				// unreadable hosts are skipped (no k-mers) - the scan is not repeated for them
+				if (!loaded) {
+					std::lock_guard<std::mutex> lck(mtx);
+					cerr << "Unable to open host file (skipped): " << loader.getPath(host_id) << endl;
+					++numSkipped;
+					continue;
+				}
+
+				KmerDatabase::extractUniqueKmers(*fasta, 0, fasta->numSubsequences(), ks, hostKmers);
+				fasta.reset();
+
+				string name = getFileName(loader.getPath(host_id));
+				for (size_t j = 0; j < numK; ++j) {
+					hosts[j][host_id] = Organism(name, (uint32_t)hostKmers[j].size());
+
+					// hits identify phages here
+					dbs[j].query(hostKmers[j], counters, hits);
+					for (const Hit& h : hits) {
+						Best& b = local[j][h.host_id];
+						if (h.common_kmers > b.common_kmers) {
+							b.common_kmers = h.common_kmers;
+							b.host_ids.assign(1, (uint32_t)host_id);
+						}
+						else if (h.common_kmers == b.common_kmers) {
+							b.host_ids.push_back((uint32_t)host_id);
+						}
+					}
+				}
+			}
+		}, tid);
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	if (numSkipped) {
+		cerr << "Warning: " << numSkipped << " host(s) could not be loaded and were skipped" << endl;
+	}
+
+	// only loaded hosts are potential ones
+	uint32_t numHosts = (uint32_t)(loader.size() - numSkipped);
+
+	for (size_t j = 0; j < numK; ++j) {
+		const KmerDatabase& db = dbs[j];
+		vector<Phage> phages;
+
+		for (uint32_t phage_id = 0; phage_id < numPhages; ++phage_id) {
+			const Organism& org = db.getOrganisms()[phage_id];
+			phages.emplace_back(org.name, org.kmer_count);
+
+			// merge results of threads - ties are added in the increasing order of host identifiers
+			uint32_t common = 0;
+			vector<uint32_t> ids;
+			for (auto& local : best) {
+				Best& b = local[j][phage_id];
+				if (b.common_kmers > common) {
+					common = b.common_kmers;
+					ids.clear();
+				}
+				if (b.common_kmers == common && common > 0) {
+					ids.insert(ids.end(), b.host_ids.begin(), b.host_ids.end());
+				}
+				vector<uint32_t>().swap(b.host_ids);
+			}
+
+			std::sort(ids.begin(), ids.end());
+			for (uint32_t host_id : ids) {
+				phages.back().addHit(host_id, common);
+			}
+		}
+
+		string path = numK > 1 ? outputPathForK(outputPath, db.getK()) : outputPath;
+		ofstream output(path);
+		if (!output) {
+			cerr << "Unable to create output file: " << path << endl;
+			return false;
+		}
+		storePredictions(output, phages, hosts[j], numHosts, db.getK());
+		cerr << "Predictions stored in " << path << endl;
+	}
+
+	return true;
+}
+
+#ifndef _WIN32
+// *****************************************************************************************
+//
+void handleConnection(const HostDatabase& db, bool multisample, int fd) {
+
+	string pending;
+	char buffer[4096];
+	ssize_t n;
+
+	while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+		pending.append(buffer, n);
+
+		size_t newline;
+		while ((newline = pending.find('\n')) != string::npos) {
+			string request = pending.substr(0, newline);
+			pending.erase(0, newline + 1);
+
+			if (request.size() && request.back() == '\r') {
+				request.pop_back();
+			}
+			if (request.empty()) {
+				continue;
+			}
+
+			ostringstream response;
+			handleRequest(db, multisample, request, response);
+
+			string out = response.str();
+			for (size_t sent = 0; sent < out.size(); ) {
+				ssize_t ret = write(fd, out.data() + sent, out.size() - sent);
+				if (ret <= 0) {
+					close(fd);
+					return;
+				}
+				sent += ret;
+			}
+		}
+	}
+
+	close(fd);
+}
+
+// *****************************************************************************************
+//
+bool serveSocket(const HostDatabase& db, bool multisample, const string& path) {
+
+	sockaddr_un addr;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		cerr << "Socket path too long: " << path << endl;
+		return false;
+	}
+
+	// client disconnections must not terminate the server
+	signal(SIGPIPE, SIG_IGN);
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		cerr << "Unable to create socket" << endl;
+		return false;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	unlink(path.c_str());
+
+	if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listener, 16) < 0) {
+		cerr << "Unable to listen on socket: " << path << endl;
+		close(listener);
+		return false;
+	}
+
+	cerr << "Listening on " << path << endl;
+
+	// database is read-only - connections are served concurrently
+	int fd;
+	while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+		std::thread(handleConnection, std::cref(db), multisample, fd).detach();
+	}
+
+	close(listener);
+	return true;
+}
+#endif
+
+
+int main(int argc, char** argv) {
+
+	cerr << "PHIST-Server utility 1.0.0" << endl
+		<< "A.Zielezinski, S. Deorowicz, A. Gudys (c) 2021" << endl << endl;
+
+	std::vector<std::string> params(argc - 1);
+	std::transform(argv + 1, argv + argc, params.begin(), [](char* s)->string { return s; });
+
+	// one or more comma-separated k-mer lengths (several only in the streaming mode)
+	string kList;
+	if (!findOption(params, "-k", kList)) {
+		kList = "25";
+	}
+
+	vector<uint32_t> ks;
+	bool kValid = true;
+	std::istringstream kStream(kList);
+	for (string token; getline(kStream, token, ','); ) {
+		int k = atoi(token.c_str());
+		kValid &= (k >= 3 && k <= 30) && std::find(ks.begin(), ks.end(), (uint32_t)k) == ks.end();
+		ks.push_back(k);
+	}
+
+	int numThreads;
+	if (!findOption(params, "-t", numThreads)) {
+		numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+	}
+
+	string socketPath;
+	findOption(params, "-socket", socketPath);
+
+	string phageList, outputPath;
+	findOption(params, "-phages", phageList);
+	findOption(params, "-output", outputPath);
+
+	bool multisample = findSwitch(params, "-multisample-fasta");
+
+	if (params.size() != 1 || ks.empty() || !kValid || phageList.empty() != outputPath.empty() || (phageList.empty() && ks.size() > 1)) {
+		cerr << "USAGE:" << endl
+			<< "server [options] <hosts>" << endl << endl
+			<< "Parameters:" << endl
+			<< "\thosts - text file with host FASTA paths (one per line, gzipped or not) or a host archive" << endl << endl
+			<< "Options:" << endl
+			<< "\t-k <length>[,<length>...] - k-mer length (25 by default, 3-30); several lengths are allowed" << endl
+			<< "\t   in the streaming mode (k-mers of all lengths are extracted from a host in a single pass)" << endl
+			<< "\t-t <threads> - number of threads loading hosts (number of cores by default)" << endl
+			<< "\t-multisample-fasta - each record of a query FASTA is a separate phage" << endl
+			<< "\t-phages <phage_list> - text file with phage FASTA paths (one per line) to be processed" << endl
+			<< "\t   in the streaming mode (requires -output)" << endl
+			<< "\t-output <predictions> - output file of the streaming mode" << endl
+#ifndef _WIN32
+			<< "\t-socket <path> - serve queries on a UNIX socket instead of standard input" << endl
+#endif
+			<< endl
+			<< "Each request is a line with a phage FASTA path, optionally followed by a tab and" << endl
+			<< "an output path. Predictions (in the format of phist utility) are written to the" << endl
+			<< "output file (response: OK) or returned directly. Failures are reported as ERROR." << endl
+			<< "Every response is terminated by an empty line." << endl << endl
+			<< "In the streaming mode, k-mers of phages are kept in memory and hosts are loaded one" << endl
+			<< "by one, so the host collection may exceed the memory. Predictions are stored in" << endl
+			<< "the output file (with .k<length> before the extension for several k-mer lengths)." << endl;
+		return 0;
+	}
+
+	if (phageList.size()) {
+		vector<string> phagePaths;
+		if (!loadList(phageList, phagePaths)) {
+			cerr << "Unable to open phage list: " << phageList << endl;
+			return -1;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		cerr << "Indexing " << phagePaths.size() << " phage files (k = " << kList << ")..." << endl;
+
+		vector<KmerDatabase> phageDbs;
+		for (uint32_t k : ks) {
+			phageDbs.emplace_back(k);
+		}
+		if (!indexPhages(phagePaths, multisample, numThreads, phageDbs)) {
+			return -1;
+		}
+
+		auto time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start);
+		cerr << phageDbs.front().getOrganisms().size() << " phages indexed in " << time.count() << " seconds" << endl;
+
+		// hosts are freed right after processing - their memory is bounded by the loader queue
+		bool isArchive = FastaArchive::isArchive(params[0]);
+		FastaArchive archive;
+		vector<string> hostPaths;
+		if (isArchive ? !archive.open(params[0]) : !loadList(params[0], hostPaths)) {
+			cerr << "Unable to open " << (isArchive ? "host archive: " : "host list: ") << params[0] << endl;
+			return -1;
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+		std::unique_ptr<FastaLoader> loader(isArchive
+			? new FastaLoader(archive, std::max(1, numThreads / 2), 2 * numThreads, (size_t)1 << 30)
+			: new FastaLoader(hostPaths, std::max(1, numThreads / 2), 2 * numThreads, (size_t)1 << 30));
+
+		cerr << "Streaming " << loader->size() << " hosts..." << endl;
+		if (!streamHosts(*loader, phageDbs, numThreads, outputPath)) {
+			return -1;
+		}
+
+		time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start);
+		cerr << "Hosts processed in " << time.count() << " seconds" << endl;
+		return 0;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	uint32_t k = ks.front();
+	HostDatabase db(k);
+
+	if (FastaArchive::isArchive(params[0])) {
+		FastaArchive archive;
+		if (!archive.open(params[0])) {
+			cerr << "Unable to open host archive: " << params[0] << endl;
+			return -1;
+		}
+
+		cerr << "Loading " << archive.size() << " hosts from archive (k = " << k << ")..." << endl;
+		if (!db.build(archive, numThreads)) {
+			return -1;
+		}
+	}
+	else {
+		vector<string> hostPaths;
+		if (!loadList(params[0], hostPaths)) {
+			cerr << "Unable to open host list: " << params[0] << endl;
+			return -1;
+		}
+
+		cerr << "Loading " << hostPaths.size() << " hosts (k = " << k << ")..." << endl;
+		if (!db.build(hostPaths, numThreads)) {
+			return -1;
+		}
+	}
+
+	auto time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start);
+	cerr << db.numKmers() << " distinct k-mers loaded in " << time.count() << " seconds" << endl;
+
+	if (socketPath.size()) {
+#ifndef _WIN32
+		return serveSocket(db, multisample, socketPath) ? 0 : -1;
+#else
+		cerr << "UNIX sockets are not supported on this platform" << endl;
+		return -1;
+#endif
+	}
+
+	cerr << "Waiting for requests on standard input..." << endl;
+
+	string request;
+	while (getline(cin, request)) {
+		if (request.size() && request.back() == '\r') {
+			request.pop_back();
+		}
+		if (request.empty()) {
+			continue;
+		}
+
+		handleRequest(db, multisample, request, cout);
+		cout.flush();
+	}
+
+	return 0;
+}
@@ -0,0 +1,258 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "spacer_search.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// *****************************************************************************************
+//
+void SpacerIndex::pack(const char* sequence, size_t length, std::vector<uint64_t>& words, std::vector<uint64_t>& masks) {
+	const char* map = get_symbol_map();
+	
+	// one extra word for reading unaligned windows
+	size_t numWords = length / 32 + 2;
+	words.assign(numWords, 0);
+	masks.assign(numWords, 0);
+
+	for (size_t i = 0; i < length; ++i) {
+		char symb = map[static_cast<unsigned char>(sequence[i])];
+		int shift = (int)(i & 31) * 2;
+		if (symb < 0) {
+			masks[i >> 5] |= 3ull << shift;
+		}
+		else {
+			words[i >> 5] |= (uint64_t)symb << shift;
+		}
+	}
+}
+
+// *****************************************************************************************
+//
+void SpacerIndex::build(const FastaFile& spacers, int mismatches, int seedLength) {
+	this->mismatches = mismatches;
+	this->seedLength = seedLength;
+	numSpacers = spacers.numSubsequences();
+	skipped = 0;
+
+	seeds.clear();
+	lengths.resize(numSpacers);
+
+	AlwaysPassFilter apf;
+	std::vector<kmer_t> kmers;
+	std::vector<uint32_t> positions;
+	int numRegions = mismatches + 1;
+	size_t maxLength = 0;
+
+	for (uint32_t id = 0; id < numSpacers; ++id) {
+		char* seq = spacers.getSubsequences()[id];
+		size_t len = spacers.getLengths()[id];
+		lengths[id] = (uint32_t)len;
+		
+		if (len < (size_t)numRegions * seedLength || len > SPACER_MAX_LENGTH) {
+			++skipped;
+			continue;
+		}
+		maxLength = std::max(maxLength, len);
+
+		kmers.resize(len - seedLength + 1);
+		positions.resize(len - seedLength + 1);
+		size_t count = extract_kmers<KmerMode::Forward, AlwaysPassFilter>(seq, len, seedLength, apf, kmers.data(), positions.data());
+		
+		// seeds at region starts (seeds with non-ACGT symbols are missing, but then 
+		// the region has a mismatch anyway)
+		size_t j = 0;
+		for (int r = 0; r < numRegions; ++r) {
+			uint32_t offset = (uint32_t)(r * len / numRegions);
+			while (j < count && positions[j] < offset) {
+				++j;
+			}
+			if (j < count && positions[j] == offset) {
+				seeds.push_back(Seed{ kmers[j], id, (uint16_t)offset, (uint16_t)len });
+			}
+		}
+	}
+
+	std::sort(seeds.begin(), seeds.end(), [](const Seed& a, const Seed& b) {
+		return a.kmer < b.kmer || (a.kmer == b.kmer && a.spacer < b.spacer);
+	});
+
+	// buckets by up to 20 most significant bits of seeds (short k-mers are extracted with 
+	// additional low bits, see extract_kmers_generic)
+	int kmerBits = std::max(2 * seedLength, 2 * SUFFIX_LEN + 8);
+	int prefixBits = std::min(2 * seedLength, 20);
+	bucketShift = kmerBits - prefixBits;
+	buckets.assign(((size_t)1 << prefixBits) + 1, 0);
+	for (const Seed& s : seeds) {
+		++buckets[(s.kmer >> bucketShift) + 1];
+	}
+	for (size_t i = 1; i < buckets.size(); ++i) {
+		buckets[i] += buckets[i - 1];
+	}
+
+	// copies of packed spacers in the order of seeds
+	stride = (maxLength + 31) / 32;
+	seedData.assign(seeds.size() * 2 * stride, 0);
+	std::vector<uint64_t> words, masks;
+	for (size_t i = 0; i < seeds.size(); ++i) {
+		uint32_t id = seeds[i].spacer;
+		pack(spacers.getSubsequences()[id], lengths[id], words, masks);
+		std::copy_n(words.begin(), (lengths[id] + 31) / 32, seedData.begin() + i * 2 * stride);
+		std::copy_n(masks.begin(), (lengths[id] + 31) / 32, seedData.begin() + i * 2 * stride + stride);
+	}
+}
+
+// *****************************************************************************************
+//
+int SpacerIndex::verify(size_t seed_id, const uint64_t* textWords, const uint64_t* textMasks, size_t pos, uint64_t* diffs) const {
+	const uint64_t LOW_BITS = 0x5555555555555555ull;
+	
+	const uint64_t* spacerWords = seedData.data() + seed_id * 2 * stride;
+	const uint64_t* spacerMasks = spacerWords + stride;
+	uint32_t len = seeds[seed_id].length;
+	
+	int mm = 0;
+	for (uint32_t done = 0, w = 0; done < len; done += 32, ++w) {
+		// window of 32 text symbols starting at pos + done
+		size_t p = pos + done;
+		int shift = (int)(p & 31) * 2;
+		uint64_t tw = textWords[p >> 5] >> shift;
+		uint64_t tm = textMasks[p >> 5] >> shift;
+		if (shift) {
+			tw |= textWords[(p >> 5) + 1] << (64 - shift);
+			tm |= textMasks[(p >> 5) + 1] << (64 - shift);
+		}
+
+		uint64_t diff = tw ^ spacerWords[w];
+		diff = ((diff | (diff >> 1)) | tm | spacerMasks[w]) & LOW_BITS;
+		if (len - done < 32) {
+			diff &= (1ull << (2 * (len - done))) - 1;
+		}
+
+		diffs[w] = diff;
+		mm += popcount64(diff);
+		if (mm > mismatches) {
+			break;
+		}
+	}
+
+	return mm;
+}
+
+// *****************************************************************************************
+//
+void SpacerIndex::scanStrand(
+	const std::string& text,
+	std::vector<kmer_t>& kmers,
+	std::vector<uint32_t>& positions,
+	uint16_t is_rev,
+	std::vector<SpacerHit>& hits) const {
+
+	size_t len = text.size();
+	if (len < (size_t)seedLength) {
+		return;
+	}
+
+	AlwaysPassFilter apf;
+	kmers.resize(len - seedLength + 1);
+	positions.resize(len - seedLength + 1);
+	size_t count = extract_kmers<KmerMode::Forward, AlwaysPassFilter>(
+		const_cast<char*>(text.data()), len, seedLength, apf, kmers.data(), positions.data());
+
+	std::vector<uint64_t> textWords, textMasks;
+	pack(text.data(), len, textWords, textMasks);
+	
+	int numRegions = mismatches + 1;
+	uint64_t diffs[SPACER_MAX_LENGTH / 32];
+
+	for (size_t i = 0; i < count; ++i) {
+		kmer_t kmer = kmers[i];
+		size_t prefix = kmer >> bucketShift;
+		size_t first = buckets[prefix];
+		size_t last = buckets[prefix + 1];
+		if (bucketShift > 0) {
+			first = std::lower_bound(seeds.begin() + first, seeds.begin() + last, kmer, 
+				[](const Seed& s, kmer_t k) { return s.kmer < k; }) - seeds.begin();
+		}
+
+		for (size_t s = first; s < last && seeds[s].kmer == kmer; ++s) {
+			const Seed& seed = seeds[s];
+			if (positions[i] < seed.offset || positions[i] - seed.offset + seed.length > len) {
+				continue;
+			}
+			
+			size_t start = positions[i] - seed.offset;
+			int mm = verify(s, textWords.data(), textMasks.data(), start, diffs);
+			if (mm > mismatches) {
+				continue;
+			}
+
+			// the window is reported only by the first region with no mismatches
+			bool earlier = false;
+			for (int r = 0; r < numRegions && !earlier; ++r) {
+				size_t offset = r * seed.length / numRegions;
+				if (offset == seed.offset) {
+					break;
+				}
+
+				earlier = true;
+				for (size_t p = offset; p < offset + seedLength; ++p) {
+					if ((diffs[p >> 5] >> (2 * (p & 31))) & 1) {
+						earlier = false;
+						break;
+					}
+				}
+			}
+
+			if (!earlier) {
+				// report windows on the forward strand
+				uint32_t pos = is_rev ? (uint32_t)(len - start - seed.length) : (uint32_t)start;
+				hits.push_back(SpacerHit{ seed.spacer, pos, is_rev, (uint16_t)mm });
+			}
+		}
+	}
+}
+
+// *****************************************************************************************
+//
+void SpacerIndex::search(const char* sequence, size_t length, std::vector<SpacerHit>& hits) const {
+	hits.clear();
+	
+	std::vector<kmer_t> kmers;
+	std::vector<uint32_t> positions;
+
+	std::string text(sequence, length);
+	scanStrand(text, kmers, positions, 0, hits);
+
+	// reverse complement (non-ACGT symbols become N)
+	const char* map = get_symbol_map();
+	const char* complement = "TGCA";
+	for (size_t i = 0; i < length; ++i) {
+		char symb = map[static_cast<unsigned char>(sequence[length - 1 - i])];
+		text[i] = symb < 0 ? 'N' : complement[(int)symb];
+	}
+	scanStrand(text, kmers, positions, 1, hits);
+
+	std::sort(hits.begin(), hits.end(), [](const SpacerHit& a, const SpacerHit& b) {
+		if (a.pos != b.pos) { return a.pos < b.pos; }
+		if (a.spacer != b.spacer) { return a.spacer < b.spacer; }
+		return a.is_rev < b.is_rev;
+	});
+}
@@ -0,0 +1,112 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_file.h"
+#include "kmer_helper.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// allowed lengths of exact seeds and of spacers
+#define SPACER_MIN_SEED 8
+#define SPACER_MAX_SEED 16
+#define SPACER_MAX_LENGTH 256
+
+// *****************************************************************************************
+// Match of a spacer against a phage window of the spacer length (Hamming distance).
+struct SpacerHit {
+	uint32_t spacer;
+	uint32_t pos;			// start of the window on the forward phage strand
+	uint16_t is_rev;		// the spacer matches the reverse complement of the window
+	uint16_t mismatches;
+};
+
+// *****************************************************************************************
+// Index of short host sequences (e.g. CRISPR spacers) for mismatch-tolerant search. Every 
+// spacer is split into mismatches + 1 regions, so that one of them has no mismatches in any 
+// occurrence within the budget (pigeonhole principle). Seeds taken from the beginnings of 
+// the regions are indexed, candidate windows are verified on 2-bit packed sequences.
+class SpacerIndex {
+public:
+	// spacers shorter than (mismatches + 1) * seedLength or longer than SPACER_MAX_LENGTH 
+	// are not indexed
+	void build(const FastaFile& spacers, int mismatches, int seedLength);
+
+	// finds all occurrences of the spacers on both strands of the sequence
+	void search(const char* sequence, size_t length, std::vector<SpacerHit>& hits) const;
+
+	size_t numIndexed() const { return numSpacers - skipped; }
+	size_t numSkipped() const { return skipped; }
+	size_t numSeeds() const { return seeds.size(); }
+
+	uint32_t getLength(uint32_t spacer) const { return lengths[spacer]; }
+
+	// 32 bases per word (2 bits each, the first base in the lowest bits); non-ACGT symbols 
+	// are marked with 11 in the mask
+	static void pack(const char* sequence, size_t length, std::vector<uint64_t>& words, std::vector<uint64_t>& masks);
+
+protected:
+	struct Seed {
+		kmer_t kmer;
+		uint32_t spacer;
+		uint16_t offset;		// beginning of the region
+		uint16_t length;		// of the spacer
+	};
+
+	int mismatches;
+	int seedLength;
+	size_t numSpacers;
+	size_t skipped;
+
+	std::vector<Seed> seeds;			// sorted by k-mers
+	std::vector<uint32_t> buckets;		// first seed with given prefix of the k-mer
+	int bucketShift;
+	std::vector<uint32_t> lengths;
+
+	// packed spacer words followed by masks for every seed, so that verification of the 
+	// candidates reads memory next to the seeds
+	size_t stride;
+	std::vector<uint64_t> seedData;
+
+	void scanStrand(
+		const std::string& text,
+		std::vector<kmer_t>& kmers,
+		std::vector<uint32_t>& positions,
+		uint16_t is_rev,
+		std::vector<SpacerHit>& hits) const;
+
+	// number of mismatches between the spacer of the seed and the window (stops after 
+	// exceeding the limit); bits of mismatching positions are stored in diffs
+	int verify(size_t seed_id, const uint64_t* textWords, const uint64_t* textMasks, size_t pos, uint64_t* diffs) const;
+};
+
+// *****************************************************************************************
+//
+inline int popcount64(uint64_t x) {
+#ifdef _MSC_VER
+	return (int)__popcnt64(x);
+#else
+	return __builtin_popcountll(x);
+#endif
+}
@@ -0,0 +1,342 @@
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "suffix_array.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// *****************************************************************************************
+// SA-IS
+namespace {
+
+template <class T>
+void getBuckets(const T* s, size_t n, int maxSymbol, std::vector<int32_t>& bkt, bool end) {
+	std::fill(bkt.begin(), bkt.end(), 0);
+	for (size_t i = 0; i < n; ++i) {
+		++bkt[s[i]];
+	}
+
+	int32_t sum = 0;
+	for (int c = 0; c <= maxSymbol; ++c) {
+		sum += bkt[c];
+		bkt[c] = end ? sum : sum - bkt[c];
+	}
+}
+
+// types of suffixes: S (true) or L (false)
+inline bool isLMS(const std::vector<bool>& t, int32_t i) { return i > 0 && t[i] && !t[i - 1]; }
+
+template <class T>
+void induce(const T* s, int32_t* sa, size_t n, int maxSymbol, const std::vector<bool>& t, std::vector<int32_t>& bkt) {
+	// L-type suffixes from left to right
+	getBuckets(s, n, maxSymbol, bkt, false);
+	for (size_t i = 0; i < n; ++i) {
+		int32_t j = sa[i] - 1;
+		if (sa[i] > 0 && !t[j]) {
+			sa[bkt[s[j]]++] = j;
+		}
+	}
+
+	// S-type suffixes from right to left
+	getBuckets(s, n, maxSymbol, bkt, true);
+	for (size_t i = n; i-- > 0; ) {
+		int32_t j = sa[i] - 1;
+		if (sa[i] > 0 && t[j]) {
+			sa[--bkt[s[j]]] = j;
+		}
+	}
+}
+
+template <class T>
+void sais(const T* s, int32_t* sa, size_t n, int maxSymbol) {
+
+	std::vector<bool> t(n);
+	t[n - 1] = true;
+	for (size_t i = n - 1; i-- > 0; ) {
+		t[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && t[i + 1]);
+	}
+
+	// stage 1: sort LMS substrings
+	std::vector<int32_t> bkt(maxSymbol + 1);
+	getBuckets(s, n, maxSymbol, bkt, true);
+	std::fill(sa, sa + n, -1);
+	for (size_t i = 1; i < n; ++i) {
+		if (isLMS(t, (int32_t)i)) {
+			sa[--bkt[s[i]]] = (int32_t)i;
+		}
+	}
+	induce(s, sa, n, maxSymbol, t, bkt);
+
+	// compact sorted LMS substrings
+	size_t n1 = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (isLMS(t, sa[i])) {
+			sa[n1++] = sa[i];
+		}
+	}
+
+	// name LMS substrings
+	std::fill(sa + n1, sa + n, -1);
+	int32_t name = 0;
+	int32_t prev = -1;
+	for (size_t i = 0; i < n1; ++i) {
+		int32_t pos = sa[i];
+		bool diff = false;
+		for (int32_t d = 0; ; ++d) {
+			if (prev == -1 || s[pos + d] != s[prev + d] || t[pos + d] != t[prev + d]) {
+				diff = true;
+				break;
+			}
+			if (d > 0 && (isLMS(t, pos + d) || isLMS(t, prev + d))) {
+				break;
+			}
+		}
+
+		if (diff) {
+			++name;
+			prev = pos;
+		}
+		sa[n1 + pos / 2] = name - 1;
+	}
+	for (size_t i = n, j = n; i-- > n1; ) {
+		if (sa[i] >= 0) {
+			sa[--j] = sa[i];
+		}
+	}
+
+	// stage 2: sort the reduced problem
+	int32_t* s1 = sa + n - n1;
+	if ((size_t)name < n1) {
+		sais(s1, sa, n1, name - 1);
+	}
+	else {
+		for (size_t i = 0; i < n1; ++i) {
+			sa[s1[i]] = (int32_t)i;
+		}
+	}
+
+	// stage 3: induce the result from sorted LMS suffixes
+	for (size_t i = 1, j = 0; i < n; ++i) {
+		if (isLMS(t, (int32_t)i)) {
+			s1[j++] = (int32_t)i;
+		}
+	}
+	for (size_t i = 0; i < n1; ++i) {
+		sa[i] = s1[sa[i]];
+	}
+	std::fill(sa + n1, sa + n, -1);
+
+	getBuckets(s, n, maxSymbol, bkt, true);
+	for (size_t i = n1; i-- > 0; ) {
+		int32_t j = sa[i];
+		sa[i] = -1;
+		sa[--bkt[s[j]]] = j;
+	}
+	induce(s, sa, n, maxSymbol, t, bkt);
+}
+
+}
+
+// *****************************************************************************************
+//
+void SuffixArray::build(std::vector<uint8_t>&& text, int maxSymbol, int maxDepth) {
+	this->text = std::move(text);
+	sa.resize(this->text.size());
+	if (sa.size() > 1) {
+		sais(this->text.data(), sa.data(), sa.size(), maxSymbol);
+	}
+	else if (sa.size() == 1) {
+		sa[0] = 0;
+	}
+
+	buildLcp(std::min(maxDepth, 255));
+	buildRanks();
+}
+
+// *****************************************************************************************
+// LCP values with previous and next smaller values, which locate the bounds of parent intervals.
+void SuffixArray::buildLcp(int maxDepth) {
+	size_t n = sa.size();
+	LcpEntry none = { 0, (uint32_t)n, 0 };
+	lcp.assign(n + 1, none);
+
+	// permuted LCP (Karkkainen, Manzini, and Puglisi, 2009): suffixes are compared in the text 
+	// order, which is cache-friendly, and values are then permuted to the suffix order; as LCP 
+	// is stored up to maxDepth, comparisons stop there (the carried value remains a lower bound)
+	std::vector<int32_t> plcp(n);
+	if (n > 0) {
+		plcp[sa[0]] = -1;
+	}
+	for (size_t r = 1; r < n; ++r) {
+		plcp[sa[r]] = sa[r - 1];
+	}
+
+	size_t h = 0;
+	for (size_t i = 0; i < n; ++i) {
+		int32_t j = plcp[i];
+		if (j < 0) {
+			plcp[i] = 0;
+			h = 0;
+			continue;
+		}
+
+		while (h < (size_t)maxDepth && text[i + h] == text[j + h]) {
+			++h;
+		}
+		plcp[i] = (int32_t)h;
+		if (h > 0) {
+			--h;
+		}
+	}
+
+	for (size_t r = 1; r < n; ++r) {
+		lcp[r].value = (uint8_t)plcp[sa[r]];
+	}
+	std::vector<int32_t>().swap(plcp);
+
+	std::vector<uint32_t> stack;
+	for (size_t i = 0; i <= n; ++i) {
+		while (!stack.empty() && lcp[stack.back()].value > lcp[i].value) {
+			lcp[stack.back()].nextSmaller = (uint32_t)i;
+			stack.pop_back();
+		}
+		stack.push_back((uint32_t)i);
+	}
+
+	stack.clear();
+	for (size_t i = 0; i <= n; ++i) {
+		while (!stack.empty() && lcp[stack.back()].value >= lcp[i].value) {
+			stack.pop_back();
+		}
+		lcp[i].prevSmaller = stack.empty() ? 0 : stack.back();
+		stack.push_back((uint32_t)i);
+	}
+}
+
+// *****************************************************************************************
+//
+void SuffixArray::buildRanks() {
+	size_t n = sa.size();
+	ranks.assign(n / 64 + 1, RankBlock());
+
+	uint32_t counts[4] = { 0, 0, 0, 0 };
+	for (size_t b = 0; b < ranks.size(); ++b) {
+		RankBlock& block = ranks[b];
+		for (int c = 0; c < 4; ++c) {
+			block.counts[c] = counts[c];
+			block.bits[c] = 0;
+		}
+
+		for (size_t i = b * 64; i < std::min(n, b * 64 + 64); ++i) {
+			uint8_t symb = sa[i] > 0 ? text[sa[i] - 1] : 0;
+			if (symb >= 1 && symb <= 4) {
+				block.bits[symb - 1] |= 1ull << (i & 63);
+				++counts[symb - 1];
+			}
+		}
+	}
+
+	// the text contains a single 0 which precedes all nucleotides
+	firstSuffix[1] = n > 0 ? 1 : 0;
+	for (int c = 1; c < 4; ++c) {
+		firstSuffix[c + 1] = firstSuffix[c] + counts[c - 1];
+	}
+}
+
+// *****************************************************************************************
+// Number of occurrences of the nucleotide c in the transform before position i.
+uint32_t SuffixArray::rank(uint8_t c, uint32_t i) const {
+	const RankBlock& block = ranks[i >> 6];
+	uint64_t before = block.bits[c - 1] & ((1ull << (i & 63)) - 1);
+#ifdef _MSC_VER
+	return block.counts[c - 1] + (uint32_t)__popcnt64(before);
+#else
+	return block.counts[c - 1] + (uint32_t)__builtin_popcountll(before);
+#endif
+}
+
+// *****************************************************************************************
+//
+bool SuffixArray::extend(uint8_t c, uint32_t& lo, uint32_t& hi) const {
+	uint32_t newLo = firstSuffix[c] + rank(c, lo);
+	uint32_t newHi = firstSuffix[c] + rank(c, hi);
+	if (newLo == newHi) {
+		return false;
+	}
+
+	lo = newLo;
+	hi = newHi;
+	return true;
+}
+
+// *****************************************************************************************
+// The parent shares the longer of the prefixes common with the neighbouring suffixes; its 
+// bounds are the nearest positions with smaller LCP values.
+uint32_t SuffixArray::parent(uint32_t& lo, uint32_t& hi) const {
+	uint32_t depth = boundaryLcp(lo, hi);
+	if (depth == 0) {
+		lo = 0;
+		hi = (uint32_t)sa.size();
+		return 0;
+	}
+
+	const LcpEntry& left = lcp[lo];
+	const LcpEntry& right = lcp[hi];
+	if (left.value == depth) {
+		lo = left.prevSmaller;
+	}
+	if (right.value == depth) {
+		hi = right.nextSmaller;
+	}
+	return depth;
+}
+
+// *****************************************************************************************
+// Suffixes preceded by c are skipped a word of the transform at a time.
+void SuffixArray::notPreceded(uint32_t lo, uint32_t hi, uint8_t c, std::vector<uint32_t>& positions) const {
+	if (c < 1 || c > 4) {
+		for (uint32_t i = lo; i < hi; ++i) {
+			positions.push_back((uint32_t)sa[i]);
+		}
+		return;
+	}
+
+	while (lo < hi) {
+		uint32_t blockEnd = std::min(hi, (lo | 63) + 1);
+		uint64_t other = ~ranks[lo >> 6].bits[c - 1] >> (lo & 63);
+		if (blockEnd - lo < 64) {
+			other &= (1ull << (blockEnd - lo)) - 1;
+		}
+
+		while (other) {
+#ifdef _MSC_VER
+			unsigned long bit;
+			_BitScanForward64(&bit, other);
+#else
+			int bit = __builtin_ctzll(other);
+#endif
+			positions.push_back((uint32_t)sa[lo + bit]);
+			other &= other - 1;
+		}
+		lo = blockEnd;
+	}
+}
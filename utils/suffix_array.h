@@ -0,0 +1,83 @@
+#pragma once
+/*******************************************************************************
+
+PHIST
+Copyright (C) 2021, A. Zielezinski, S. Deorowicz, and A. Gudys
+https://github.com/refresh-bio/PHIST
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this
+program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// *****************************************************************************************
+// Suffix array of a text over a small integer alphabet, built in linear time with SA-IS
+// (Nong, Zhang, and Chan, 2009), with the LCP array (Kasai et al., 2001) and ranks of
+// nucleotides (symbols 1-4) in the Burrows-Wheeler transform. Patterns are matched by
+// backward search; widening an interval to its parent when a pattern cannot be extended
+// gives matching statistics. The text must end with a unique smallest symbol (0).
+class SuffixArray {
+public:
+	SuffixArray() {}
+
+	// symbols of the text are in range 0-maxSymbol; LCP values are stored up to maxDepth 
+	// (at most 255), thus parents are exact for patterns not longer than maxDepth + 1
+	void build(std::vector<uint8_t>&& text, int maxSymbol, int maxDepth);
+
+	const std::vector<uint8_t>& getText() const { return text; }
+	size_t size() const { return sa.size(); }
+	uint32_t operator[](size_t i) const { return (uint32_t)sa[i]; }
+
+	// narrows the interval [lo, hi) of suffixes starting with a pattern to suffixes starting 
+	// with the pattern preceded by the nucleotide c; returns false (leaving the interval 
+	// unchanged) if there are none
+	bool extend(uint8_t c, uint32_t& lo, uint32_t& hi) const;
+
+	// widens the interval [lo, hi) to the parent interval; returns the length of the prefix 
+	// shared by its suffixes
+	uint32_t parent(uint32_t& lo, uint32_t& hi) const;
+
+	// length of the longest prefix shared with suffixes outside the interval [lo, hi)
+	uint32_t boundaryLcp(uint32_t lo, uint32_t hi) const { return lcp[lo].value > lcp[hi].value ? lcp[lo].value : lcp[hi].value; }
+
+	// appends text positions of suffixes in the interval [lo, hi) not preceded by the 
+	// nucleotide c (all suffixes for other values of c)
+	void notPreceded(uint32_t lo, uint32_t hi, uint8_t c, std::vector<uint32_t>& positions) const;
+
+protected:
+	// occurrences of nucleotides in a block of 64 symbols of the transform
+	struct RankBlock {
+		uint32_t counts[4];		// before the block
+		uint64_t bits[4];		// positions in the block
+	};
+
+	std::vector<uint8_t> text;
+	std::vector<int32_t> sa;
+
+	// LCP with the preceding suffix (0 past both ends) and positions of the previous and next 
+	// smaller values, stored together as they are read together
+	struct LcpEntry {
+		uint32_t prevSmaller;
+		uint32_t nextSmaller;
+		uint8_t value;
+	};
+	std::vector<LcpEntry> lcp;
+
+	std::vector<RankBlock> ranks;
+	uint32_t firstSuffix[5];		// interval of suffixes starting with a nucleotide
+
+	void buildLcp(int maxDepth);
+	void buildRanks();
+	uint32_t rank(uint8_t c, uint32_t i) const;
+};